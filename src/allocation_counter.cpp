@@ -0,0 +1,174 @@
+#include "allocation_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#    include <malloc.h>
+#endif
+
+namespace allocation_counter
+{
+    static std::atomic<std::uint64_t> count{0};
+
+    bool is_enabled()
+    {
+#if defined(VULKAN_INTRO_COUNT_ALLOCATIONS)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    std::uint64_t get_count()
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+#if defined(VULKAN_INTRO_COUNT_ALLOCATIONS)
+    static void* allocate(std::size_t size)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+
+        // new has to return a unique pointer even for 0 bytes.
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    static void* allocate_aligned(std::size_t size, std::align_val_t alignment)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+
+        auto align = static_cast<std::size_t>(alignment);
+#    if defined(_WIN32)
+        return _aligned_malloc(size == 0 ? 1 : size, align);
+#    else
+        // aligned_alloc wants the size to be a multiple of the alignment.
+        auto padded = std::max((size + align - 1) / align * align, align);
+        return std::aligned_alloc(align, padded);
+#    endif
+    }
+
+    static void deallocate_aligned(void* ptr)
+    {
+#    if defined(_WIN32)
+        _aligned_free(ptr);
+#    else
+        std::free(ptr);
+#    endif
+    }
+#endif
+} // namespace allocation_counter
+
+#if defined(VULKAN_INTRO_COUNT_ALLOCATIONS)
+void* operator new(std::size_t size)
+{
+    if (auto ptr = allocation_counter::allocate(size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocation_counter::allocate(size);
+}
+
+void* operator new[](std::size_t size, std::nothrow_t const&) noexcept
+{
+    return allocation_counter::allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (auto ptr = allocation_counter::allocate_aligned(size, alignment))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size,
+                   std::align_val_t alignment,
+                   std::nothrow_t const&) noexcept
+{
+    return allocation_counter::allocate_aligned(size, alignment);
+}
+
+void* operator new[](std::size_t size,
+                     std::align_val_t alignment,
+                     std::nothrow_t const&) noexcept
+{
+    return allocation_counter::allocate_aligned(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::nothrow_t const&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::nothrow_t const&) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    allocation_counter::deallocate_aligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    allocation_counter::deallocate_aligned(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    allocation_counter::deallocate_aligned(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+    allocation_counter::deallocate_aligned(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, std::nothrow_t const&) noexcept
+{
+    allocation_counter::deallocate_aligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, std::nothrow_t const&) noexcept
+{
+    allocation_counter::deallocate_aligned(ptr);
+}
+#endif
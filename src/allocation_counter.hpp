@@ -0,0 +1,13 @@
+#pragma once
+
+// Counts every call to the global operator new, so we can check that steady-state
+// rendering stays off the heap. The counting operators are only built in when
+// VULKAN_INTRO_COUNT_ALLOCATIONS is set, since replacing them affects the whole
+// program. Otherwise the count stays at 0.
+namespace allocation_counter
+{
+    bool is_enabled();
+
+    // Total number of allocations made through operator new, from any thread.
+    std::uint64_t get_count();
+} // namespace allocation_counter
@@ -0,0 +1,63 @@
+#include "linear_arena.hpp"
+
+LinearArena::LinearArena(std::size_t capacity) :
+    m_buffer{std::make_unique<std::byte[]>(capacity)},
+    m_capacity{capacity},
+    m_overflow{std::pmr::new_delete_resource()}
+{}
+
+void LinearArena::reset()
+{
+    if (m_overflow_bytes > 0)
+    {
+        // Alignment padding means the total can be a little more than what was asked
+        // for, so leave some room on top.
+        auto capacity = std::bit_ceil(m_offset + m_overflow_bytes + m_overflow_bytes / 4);
+        fmt::print("warning: frame arena overflowed by {} bytes, growing it to {} "
+                   "bytes\n",
+                   m_overflow_bytes,
+                   capacity);
+
+        m_overflow.release();
+        m_buffer         = std::make_unique<std::byte[]>(capacity);
+        m_capacity       = capacity;
+        m_overflow_bytes = 0;
+    }
+
+    m_offset = 0;
+}
+
+std::size_t LinearArena::get_capacity() const
+{
+    return m_capacity;
+}
+
+std::size_t LinearArena::get_used() const
+{
+    return m_offset + m_overflow_bytes;
+}
+
+void* LinearArena::do_allocate(std::size_t bytes, std::size_t alignment)
+{
+    void* ptr   = m_buffer.get() + m_offset;
+    auto space  = m_capacity - m_offset;
+    auto result = std::align(alignment, bytes, ptr, space);
+    if (result == nullptr)
+    {
+        m_overflow_bytes += bytes;
+        return m_overflow.allocate(bytes, alignment);
+    }
+
+    m_offset = m_capacity - space + bytes;
+    return result;
+}
+
+void LinearArena::do_deallocate(void*, std::size_t, std::size_t)
+{
+    // Everything goes away together on reset.
+}
+
+bool LinearArena::do_is_equal(std::pmr::memory_resource const& other) const noexcept
+{
+    return this == &other;
+}
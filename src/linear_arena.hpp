@@ -0,0 +1,38 @@
+#pragma once
+
+// Bump allocator for data that only lives for one frame. Allocating is a pointer bump,
+// deallocating does nothing, and everything is freed at once by reset. Anything that
+// doesn't fit goes to the heap for the rest of the frame, and the next reset grows the
+// buffer so the same frame fits next time. Once it has seen its largest frame it never
+// touches the heap again.
+//
+// Plugs into the std::pmr containers. Not thread-safe, so only use it from the thread
+// that records the frame.
+class LinearArena : public std::pmr::memory_resource
+{
+public:
+    explicit LinearArena(std::size_t capacity);
+
+    LinearArena(LinearArena const&)            = delete;
+    LinearArena& operator=(LinearArena const&) = delete;
+
+    // Invalidates everything that was allocated from the arena.
+    void reset();
+
+    std::size_t get_capacity() const;
+
+    // Bytes handed out since the last reset, including what overflowed.
+    std::size_t get_used() const;
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override;
+    bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override;
+
+    std::unique_ptr<std::byte[]> m_buffer;
+    std::size_t m_capacity{0};
+    std::size_t m_offset{0};
+
+    std::pmr::monotonic_buffer_resource m_overflow;
+    std::size_t m_overflow_bytes{0};
+};
@@ -1,8 +1,145 @@
 #include "vulkan_app.hpp"
 
-int main()
+static AppOptions parse_options(int argc, char* argv[])
 {
-    VulkanApp app;
+    AppOptions options;
+
+    auto next_arg = [&](int& i, std::string_view name) -> char const* {
+        if (i + 1 >= argc)
+        {
+            fmt::print("error: missing value for {}\n", name);
+            std::exit(1);
+        }
+
+        return argv[++i];
+    };
+
+    auto next_uint = [&](int& i, std::string_view name) -> std::uint32_t {
+        // std::stoul would throw on bad input (and quietly accept things like "2x"), so
+        // parse it ourselves and treat anything that isn't a plain number as a usage
+        // error.
+        std::string_view value{next_arg(i, name)};
+        std::uint32_t result{0};
+        auto [end, error] =
+            std::from_chars(value.data(), value.data() + value.size(), result);
+        if (error != std::errc{} || end != value.data() + value.size())
+        {
+            fmt::print("error: {} expects a non-negative integer, got '{}'\n",
+                       name,
+                       value);
+            std::exit(1);
+        }
+
+        return result;
+    };
+
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string_view arg{argv[i]};
+        if (arg == "--frames-in-flight")
+        {
+            options.frames_in_flight = next_uint(i, arg);
+            if (options.frames_in_flight == 0)
+            {
+                fmt::print("error: --frames-in-flight must be at least 1\n");
+                std::exit(1);
+            }
+        }
+        else if (arg == "--indirect")
+        {
+            options.indirect = true;
+        }
+        else if (arg == "--instanced")
+        {
+            options.instanced = true;
+        }
+        else if (arg == "--objects")
+        {
+            options.object_count = next_uint(i, arg);
+        }
+        else if (arg == "--threads")
+        {
+            options.worker_count = next_uint(i, arg);
+        }
+        else if (arg == "--optimise-meshes")
+        {
+            options.optimise_meshes = true;
+        }
+        else if (arg == "--model")
+        {
+            options.model_path = next_arg(i, arg);
+        }
+        else if (arg == "--release-geometry")
+        {
+            options.release_geometry = true;
+        }
+        else if (arg == "--parallel-recording")
+        {
+            options.parallel_recording = true;
+        }
+        else if (arg == "--present-mode")
+        {
+            std::string_view mode{next_arg(i, arg)};
+            if (mode == "fifo")
+            {
+                options.present_mode = vk::PresentModeKHR::eFifo;
+            }
+            else if (mode == "mailbox")
+            {
+                options.present_mode = vk::PresentModeKHR::eMailbox;
+            }
+            else if (mode == "immediate")
+            {
+                options.present_mode = vk::PresentModeKHR::eImmediate;
+            }
+            else
+            {
+                fmt::print("error: unknown present mode {}\n", mode);
+                std::exit(1);
+            }
+        }
+        else if (arg == "--swapchain-images")
+        {
+            options.swapchain_image_count = next_uint(i, arg);
+        }
+        else if (arg == "--frame-pacing")
+        {
+            options.frame_pacing = true;
+        }
+        else if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--frames")
+        {
+            options.frame_count = next_uint(i, arg);
+        }
+        else if (arg == "--capture")
+        {
+            options.capture_path = next_arg(i, arg);
+        }
+        else if (arg == "--trace")
+        {
+            options.trace_path = next_arg(i, arg);
+        }
+        else
+        {
+            fmt::print("warning: ignoring unknown option {}\n", arg);
+        }
+    }
+
+    if (options.indirect && options.instanced)
+    {
+        fmt::print("error: --indirect and --instanced can't be used together\n");
+        std::exit(1);
+    }
+
+    return options;
+}
+
+int main(int argc, char* argv[])
+{
+    VulkanApp app{parse_options(argc, argv)};
     app.run();
 
     return 0;
@@ -0,0 +1,28 @@
+#pragma once
+
+// Read-only memory mapping of an entire file. The mapping stays valid until the object is
+// closed or destroyed.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile const&)            = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    bool open(std::filesystem::path const& path);
+    void close();
+
+    bool is_open() const;
+    std::span<std::byte const> data() const;
+
+private:
+    std::byte const* m_data{nullptr};
+    std::size_t m_size{0};
+
+#if defined(_WIN32)
+    void* m_file{nullptr};
+    void* m_mapping{nullptr};
+#endif
+};
@@ -0,0 +1,59 @@
+#include "process_memory.hpp"
+
+#if defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+// Has to come after windows.h.
+#    include <psapi.h>
+#else
+#    include <sys/resource.h>
+#endif
+
+namespace process_memory
+{
+#if defined(_WIN32)
+    std::optional<std::size_t> get_peak_rss()
+    {
+        PROCESS_MEMORY_COUNTERS counters{};
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        {
+            return {};
+        }
+
+        return static_cast<std::size_t>(counters.PeakWorkingSetSize);
+    }
+#else
+    std::optional<std::size_t> get_peak_rss()
+    {
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0)
+        {
+            return {};
+        }
+
+        // macOS reports this in bytes, everything else in kilobytes.
+#    if defined(__APPLE__)
+        return static_cast<std::size_t>(usage.ru_maxrss);
+#    else
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#    endif
+    }
+#endif
+
+    void print_peak_rss(std::string_view label, std::size_t reference_bytes)
+    {
+        static constexpr double mb{1024.0 * 1024.0};
+
+        auto peak = get_peak_rss();
+        if (!peak)
+        {
+            fmt::print("warning: peak RSS isn't available on this platform\n");
+            return;
+        }
+
+        fmt::print("memory: peak RSS {:.1f} MB {} ({:.1f} MB of data)\n",
+                   static_cast<double>(*peak) / mb,
+                   label,
+                   static_cast<double>(reference_bytes) / mb);
+    }
+} // namespace process_memory
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace process_memory
+{
+    // Highest resident set size the process has reached so far, in bytes. Returns
+    // nothing on platforms where it can't be queried.
+    std::optional<std::size_t> get_peak_rss();
+
+    // Prints the peak resident set size next to a reference size (e.g. the size of the
+    // data that was just loaded), so the overhead on top of it is easy to spot.
+    void print_peak_rss(std::string_view label, std::size_t reference_bytes);
+} // namespace process_memory
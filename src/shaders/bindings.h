@@ -4,5 +4,26 @@
 #define VERTEX_ATTRIBUTE_LOCATION 0
 #define NORMAL_ATTRIBUTE_LOCATION 1
 #define COLOUR_ATTRIBUTE_LOCATION 2
+#define UV_ATTRIBUTE_LOCATION     3
+
+// Every graphics pipeline has the per-frame scene data in the global set, whatever the
+// render mode needs in the object set and the bindless texture array in the texture set.
+// The culling pass only has the indirect set, which it binds as set 0.
+#define GLOBAL_SET  0
+#define OBJECT_SET  1
+#define TEXTURE_SET 2
+
+#define SCENE_DATA_BINDING 0
+
+#define OBJECT_BUFFER_BINDING 0
+#define MESH_BUFFER_BINDING   1
+#define DRAW_COMMAND_BINDING  2
+#define DRAW_COUNT_BINDING    3
+
+#define INSTANCE_BUFFER_BINDING 0
+
+#define TEXTURE_ARRAY_BINDING 0
+
+#define CULL_WORKGROUP_SIZE 64
 
 #endif
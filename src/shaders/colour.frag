@@ -0,0 +1,14 @@
+#version 450 core
+
+layout (location = 0) in vec3 vert_colour;
+layout (location = 1) in vec2 vert_uv;
+layout (location = 2) flat in uint vert_texture;
+
+layout (location = 0) out vec4 frag_colour;
+
+// Used by materials without a diffuse map, which would only ever sample the white
+// texture.
+void main()
+{
+    frag_colour = vec4(vert_colour, 1);
+}
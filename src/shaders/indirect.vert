@@ -0,0 +1,27 @@
+#version 450 core
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindings.h"
+#include "vertex_input.glsl"
+#include "scene_data.glsl"
+#include "scene_uniforms.glsl"
+
+layout (location = 0) out vec3 vert_colour;
+layout (location = 1) out vec2 vert_uv;
+layout (location = 2) flat out uint vert_texture;
+
+layout (std430, set = OBJECT_SET, binding = OBJECT_BUFFER_BINDING) readonly buffer ObjectBuffer
+{
+    ObjectData objects[];
+};
+
+void main()
+{
+    // The culling pass stores the object index in firstInstance, which is folded into
+    // gl_InstanceIndex.
+    ObjectData object = objects[gl_InstanceIndex];
+    gl_Position       = scene.view_proj * object.model * vec4(get_position(), 1.0f);
+    vert_colour       = get_colour();
+    vert_uv           = get_uv();
+    vert_texture      = object.texture_index;
+}
@@ -0,0 +1,30 @@
+#version 450 core
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindings.h"
+#include "vertex_input.glsl"
+#include "scene_uniforms.glsl"
+
+layout (location = 0) out vec3 vert_colour;
+layout (location = 1) out vec2 vert_uv;
+layout (location = 2) flat out uint vert_texture;
+
+layout (std430, set = OBJECT_SET, binding = INSTANCE_BUFFER_BINDING) readonly buffer InstanceBuffer
+{
+    mat4 instances[];
+};
+
+// Every instance in a draw shares the same mesh, and with it the same texture.
+layout (push_constant) uniform constants
+{
+    uint texture_index;
+} PushConstants;
+
+void main()
+{
+    mat4 model   = instances[gl_InstanceIndex];
+    gl_Position  = scene.view_proj * model * vec4(get_position(), 1.0f);
+    vert_colour  = get_colour();
+    vert_uv      = get_uv();
+    vert_texture = PushConstants.texture_index;
+}
@@ -0,0 +1,33 @@
+#ifndef SCENE_DATA_GLSL
+#define SCENE_DATA_GLSL
+
+// These have to match GpuObjectData and GpuMeshData in vk_mesh.hpp.
+struct ObjectData
+{
+    mat4 model;
+    uint mesh_index;
+    uint texture_index;
+    uint padding0;
+    uint padding1;
+};
+
+struct MeshData
+{
+    uint index_count;
+    uint first_index;
+    int vertex_offset;
+    uint padding;
+    vec4 bounding_sphere;
+};
+
+// Same layout as VkDrawIndexedIndirectCommand.
+struct DrawCommand
+{
+    uint index_count;
+    uint instance_count;
+    uint first_index;
+    int vertex_offset;
+    uint first_instance;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SCENE_UNIFORMS_GLSL
+#define SCENE_UNIFORMS_GLSL
+
+#include "bindings.h"
+
+// Has to match GpuSceneData in vk_mesh.hpp. Bound with a dynamic offset that selects the
+// slot of the current frame.
+layout (std140, set = GLOBAL_SET, binding = SCENE_DATA_BINDING) uniform SceneBuffer
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_proj;
+} scene;
+
+#endif
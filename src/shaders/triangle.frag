@@ -1,10 +1,21 @@
 #version 450 core
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "bindings.h"
 
 layout (location = 0) in vec3 vert_colour;
+layout (location = 1) in vec2 vert_uv;
+layout (location = 2) flat in uint vert_texture;
 
 layout (location = 0) out vec4 frag_colour;
 
+// Slots that haven't finished streaming in point at a white texture, so untextured
+// meshes and ones that are still loading just show their vertex colour.
+layout (set = TEXTURE_SET, binding = TEXTURE_ARRAY_BINDING) uniform sampler2D textures[];
+
 void main()
 {
-    frag_colour = vec4(vert_colour, 1);
+    vec4 texel  = texture(textures[nonuniformEXT(vert_texture)], vert_uv);
+    frag_colour = vec4(vert_colour * texel.rgb, 1);
 }
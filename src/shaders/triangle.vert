@@ -2,21 +2,29 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "bindings.h"
-
-layout (location = VERTEX_ATTRIBUTE_LOCATION) in vec3 position;
-layout (location = NORMAL_ATTRIBUTE_LOCATION) in vec3 normal;
-layout (location = COLOUR_ATTRIBUTE_LOCATION) in vec3 colour;
+#include "vertex_input.glsl"
+#include "scene_data.glsl"
+#include "scene_uniforms.glsl"
 
 layout (location = 0) out vec3 vert_colour;
+layout (location = 1) out vec2 vert_uv;
+layout (location = 2) flat out uint vert_texture;
+
+layout (std430, set = OBJECT_SET, binding = OBJECT_BUFFER_BINDING) readonly buffer ObjectBuffer
+{
+    ObjectData objects[];
+};
 
 layout (push_constant) uniform constants
 {
-    vec4 data;
-    mat4 mvp;
+    uint object_index;
 } PushConstants;
 
 void main()
 {
-    gl_Position = PushConstants.mvp * vec4(position, 1.0f);
-    vert_colour = colour;
+    ObjectData object = objects[PushConstants.object_index];
+    gl_Position       = scene.view_proj * object.model * vec4(get_position(), 1.0f);
+    vert_colour       = get_colour();
+    vert_uv           = get_uv();
+    vert_texture      = object.texture_index;
 }
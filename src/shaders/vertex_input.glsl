@@ -0,0 +1,63 @@
+#ifndef VERTEX_INPUT_GLSL
+#define VERTEX_INPUT_GLSL
+
+// Vertex inputs for both vertex layouts. This must match Vertex in vk_mesh.hpp, and the
+// shaders should only go through the getters below.
+#if defined(VULKAN_INTRO_PACKED_VERTICES)
+layout (location = VERTEX_ATTRIBUTE_LOCATION) in vec4 in_position;
+layout (location = NORMAL_ATTRIBUTE_LOCATION) in vec2 in_normal;
+layout (location = COLOUR_ATTRIBUTE_LOCATION) in vec4 in_colour;
+layout (location = UV_ATTRIBUTE_LOCATION) in vec2 in_uv;
+
+vec3 get_position()
+{
+    return in_position.xyz;
+}
+
+vec3 get_normal()
+{
+    // Undo the octahedral encoding from vk_mesh.cpp.
+    vec3 n  = vec3(in_normal, 1.0f - abs(in_normal.x) - abs(in_normal.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+vec3 get_colour()
+{
+    return in_colour.rgb;
+}
+
+vec2 get_uv()
+{
+    return in_uv;
+}
+#else
+layout (location = VERTEX_ATTRIBUTE_LOCATION) in vec3 in_position;
+layout (location = NORMAL_ATTRIBUTE_LOCATION) in vec3 in_normal;
+layout (location = COLOUR_ATTRIBUTE_LOCATION) in vec3 in_colour;
+layout (location = UV_ATTRIBUTE_LOCATION) in vec2 in_uv;
+
+vec3 get_position()
+{
+    return in_position;
+}
+
+vec3 get_normal()
+{
+    return in_normal;
+}
+
+vec3 get_colour()
+{
+    return in_colour;
+}
+
+vec2 get_uv()
+{
+    return in_uv;
+}
+#endif
+
+#endif
@@ -0,0 +1,5 @@
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#pragma warning(pop)
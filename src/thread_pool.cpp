@@ -0,0 +1,139 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(std::size_t thread_count)
+{
+    m_workers.reserve(thread_count);
+    for (std::size_t i{0}; i < thread_count; ++i)
+    {
+        m_workers.emplace_back([this](std::stop_token stop) {
+            worker_loop(stop);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    for (auto& worker : m_workers)
+    {
+        worker.request_stop();
+    }
+    m_condition.notify_all();
+    m_workers.clear();
+}
+
+void ThreadPool::run(ParallelJob& job)
+{
+    // No point in waking up more workers than there are items, and the calling thread
+    // counts as one of them.
+    job.helpers = std::min(m_workers.size(), job.count > 0 ? job.count - 1 : 0);
+    if (job.helpers > 0)
+    {
+        {
+            std::scoped_lock lock{m_mutex};
+            m_jobs.push_back(&job);
+        }
+        m_condition.notify_all();
+    }
+
+    work_on(job);
+
+    // The helpers reference the job on this stack, so they all have to be done with it
+    // before we can leave, even if something threw.
+    {
+        std::unique_lock lock{m_mutex};
+        std::erase(m_jobs, &job);
+        m_job_done.wait(lock, [&job]() {
+            return job.active == 0;
+        });
+    }
+
+    if (job.error)
+    {
+        std::rethrow_exception(job.error);
+    }
+}
+
+void ThreadPool::work_on(ParallelJob& job)
+{
+    try
+    {
+        for (std::size_t i = job.next++; i < job.count; i = job.next++)
+        {
+            job.invoke(job.context, i);
+        }
+    }
+    catch (...)
+    {
+        // Only the first error is kept. Whoever hit it stops, the others finish off the
+        // remaining items.
+        std::scoped_lock lock{m_mutex};
+        if (!job.error)
+        {
+            job.error = std::current_exception();
+        }
+    }
+}
+
+ThreadPool::ParallelJob* ThreadPool::find_job() const
+{
+    for (auto job : m_jobs)
+    {
+        if (job->active < job->helpers && job->next < job->count)
+        {
+            return job;
+        }
+    }
+
+    return nullptr;
+}
+
+std::size_t ThreadPool::size() const
+{
+    return m_workers.size();
+}
+
+void ThreadPool::worker_loop(std::stop_token stop)
+{
+    while (true)
+    {
+        std::function<void()> task;
+        ParallelJob* job{nullptr};
+
+        {
+            std::unique_lock lock{m_mutex};
+            if (!m_condition.wait(lock, stop, [this]() {
+                    return !m_tasks.empty() || find_job() != nullptr;
+                }))
+            {
+                // Woken up by a stop request with nothing left to do.
+                return;
+            }
+
+            // Someone is blocked waiting on a parallel_for, so that goes first.
+            job = find_job();
+            if (job != nullptr)
+            {
+                ++job->active;
+            }
+            else
+            {
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+        }
+
+        if (job == nullptr)
+        {
+            task();
+            continue;
+        }
+
+        work_on(*job);
+
+        std::scoped_lock lock{m_mutex};
+        if (--job->active == 0)
+        {
+            m_job_done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// Fixed-size pool of worker threads fed from a single FIFO queue.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(std::size_t thread_count);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&)            = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    template<typename Fn>
+    auto submit(Fn&& fn) -> std::future<std::invoke_result_t<Fn>>
+    {
+        using ResultType = std::invoke_result_t<Fn>;
+
+        // std::function has to be copyable, which packaged_task isn't, so share it.
+        auto task =
+            std::make_shared<std::packaged_task<ResultType()>>(std::forward<Fn>(fn));
+        auto future = task->get_future();
+
+        {
+            std::scoped_lock lock{m_mutex};
+            m_tasks.emplace_back([task]() {
+                (*task)();
+            });
+        }
+        m_condition.notify_one();
+
+        return future;
+    }
+
+    // Calls fn(i) for every i in [0, count) and returns once all of them are done. The
+    // calling thread takes part in the work, so this is safe to use even with a single
+    // worker. Unlike submit this never allocates, so it's fine to call every frame.
+    template<typename Fn>
+    void parallel_for(std::size_t count, Fn&& fn)
+    {
+        using FnType = std::remove_reference_t<Fn>;
+
+        ParallelJob job{
+            .count   = count,
+            .context = const_cast<void*>(static_cast<void const*>(std::addressof(fn))),
+            .invoke  = [](void* context, std::size_t i) {
+                (*static_cast<FnType*>(context))(i);
+            }};
+        run(job);
+    }
+
+    std::size_t size() const;
+
+private:
+    // A parallel_for in progress. It lives on the caller's stack and workers join it
+    // directly instead of going through the task queue, which is what keeps it from
+    // allocating.
+    struct ParallelJob
+    {
+        std::size_t count{0};
+        void* context{nullptr};
+        void (*invoke)(void*, std::size_t){nullptr};
+        std::atomic<std::size_t> next{0};
+
+        // Only touched with the mutex held.
+        std::size_t helpers{0};
+        std::size_t active{0};
+        std::exception_ptr error;
+    };
+
+    void run(ParallelJob& job);
+    void work_on(ParallelJob& job);
+    ParallelJob* find_job() const;
+    void worker_loop(std::stop_token stop);
+
+    std::mutex m_mutex;
+    std::condition_variable_any m_condition;
+    std::deque<std::function<void()>> m_tasks;
+
+    // Jobs that still want helpers, and what their callers wait on for the helpers to
+    // leave. Only grows, so once it has room for every concurrent caller it stops
+    // allocating.
+    std::vector<ParallelJob*> m_jobs;
+    std::condition_variable m_job_done;
+
+    // Declared last so the workers are joined before the queue goes away.
+    std::vector<std::jthread> m_workers;
+};
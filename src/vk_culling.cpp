@@ -0,0 +1,246 @@
+#include "vk_culling.hpp"
+
+#if defined(__AVX__)
+#    include <immintrin.h>
+#    define CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define CULLING_SSE
+#endif
+
+namespace culling
+{
+    // Padding spheres fail every plane test, whatever the plane is.
+    static constexpr float padding_radius{std::numeric_limits<float>::lowest()};
+
+    Frustum extract_frustum_planes(glm::mat4 const& view_proj)
+    {
+        auto row = [&view_proj](int i) {
+            return glm::vec4{view_proj[0][i],
+                             view_proj[1][i],
+                             view_proj[2][i],
+                             view_proj[3][i]};
+        };
+
+        Frustum planes = {row(3) + row(0),
+                          row(3) - row(0),
+                          row(3) + row(1),
+                          row(3) - row(1),
+                          row(3) + row(2),
+                          row(3) - row(2)};
+
+        for (auto& plane : planes)
+        {
+            plane /= glm::length(glm::vec3{plane});
+        }
+
+        return planes;
+    }
+
+    glm::vec4 transform_sphere(glm::mat4 const& transform, glm::vec4 sphere)
+    {
+        glm::vec3 centre{transform * glm::vec4{glm::vec3{sphere}, 1.0f}};
+        float scale = std::max({glm::length(glm::vec3{transform[0]}),
+                                glm::length(glm::vec3{transform[1]}),
+                                glm::length(glm::vec3{transform[2]})});
+        return glm::vec4{centre, sphere.w * scale};
+    }
+
+    void SphereSet::clear()
+    {
+        m_x.clear();
+        m_y.clear();
+        m_z.clear();
+        m_radius.clear();
+        m_size = 0;
+    }
+
+    void SphereSet::reserve(std::size_t count)
+    {
+        auto padded = (count + lane_count - 1) / lane_count * lane_count;
+        m_x.reserve(padded);
+        m_y.reserve(padded);
+        m_z.reserve(padded);
+        m_radius.reserve(padded);
+    }
+
+    void SphereSet::push_back(glm::vec4 sphere)
+    {
+        // Grow a whole block at a time so the arrays stay padded.
+        if (m_size == m_x.size())
+        {
+            auto padded = m_size + lane_count;
+            m_x.resize(padded, 0.0f);
+            m_y.resize(padded, 0.0f);
+            m_z.resize(padded, 0.0f);
+            m_radius.resize(padded, padding_radius);
+        }
+
+        m_x[m_size]      = sphere.x;
+        m_y[m_size]      = sphere.y;
+        m_z[m_size]      = sphere.z;
+        m_radius[m_size] = sphere.w;
+        ++m_size;
+    }
+
+    std::size_t SphereSet::size() const
+    {
+        return m_size;
+    }
+
+    std::span<float const> SphereSet::get_x() const
+    {
+        return m_x;
+    }
+
+    std::span<float const> SphereSet::get_y() const
+    {
+        return m_y;
+    }
+
+    std::span<float const> SphereSet::get_z() const
+    {
+        return m_z;
+    }
+
+    std::span<float const> SphereSet::get_radius() const
+    {
+        return m_radius;
+    }
+
+    // Bit i of mask is set when sphere first + i is visible.
+    [[maybe_unused]] static void
+    append_visible(int mask, std::size_t first, std::pmr::vector<std::uint32_t>& visible)
+    {
+        auto bits = static_cast<unsigned int>(mask);
+        while (bits != 0)
+        {
+            visible.push_back(static_cast<std::uint32_t>(first + std::countr_zero(bits)));
+            bits &= bits - 1;
+        }
+    }
+
+    void cull_spheres(SphereSet const& spheres,
+                      Frustum const& frustum,
+                      std::pmr::vector<std::uint32_t>& visible)
+    {
+#if defined(CULLING_AVX)
+        visible.clear();
+
+        auto xs    = spheres.get_x();
+        auto ys    = spheres.get_y();
+        auto zs    = spheres.get_z();
+        auto radii = spheres.get_radius();
+
+        // Vector types lose their alignment attributes as template arguments, hence the
+        // plain arrays.
+        __m256 planes[6][4];
+        for (std::size_t i{0}; i < frustum.size(); ++i)
+        {
+            for (int j{0}; j < 4; ++j)
+            {
+                planes[i][j] = _mm256_set1_ps(frustum[i][j]);
+            }
+        }
+
+        for (std::size_t i{0}; i < xs.size(); i += 8)
+        {
+            __m256 x = _mm256_loadu_ps(xs.data() + i);
+            __m256 y = _mm256_loadu_ps(ys.data() + i);
+            __m256 z = _mm256_loadu_ps(zs.data() + i);
+
+            // A sphere is outside as soon as it's entirely behind any one of the planes.
+            __m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(),
+                                              _mm256_loadu_ps(radii.data() + i));
+            __m256 inside     = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (auto const& [px, py, pz, pw] : planes)
+            {
+                __m256 dist = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(x, px), _mm256_mul_ps(y, py)),
+                    _mm256_add_ps(_mm256_mul_ps(z, pz), pw));
+                inside =
+                    _mm256_and_ps(inside, _mm256_cmp_ps(dist, neg_radius, _CMP_GE_OQ));
+            }
+
+            append_visible(_mm256_movemask_ps(inside), i, visible);
+        }
+#elif defined(CULLING_SSE)
+        visible.clear();
+
+        auto xs    = spheres.get_x();
+        auto ys    = spheres.get_y();
+        auto zs    = spheres.get_z();
+        auto radii = spheres.get_radius();
+
+        // Vector types lose their alignment attributes as template arguments, hence the
+        // plain arrays.
+        __m128 planes[6][4];
+        for (std::size_t i{0}; i < frustum.size(); ++i)
+        {
+            for (int j{0}; j < 4; ++j)
+            {
+                planes[i][j] = _mm_set1_ps(frustum[i][j]);
+            }
+        }
+
+        for (std::size_t i{0}; i < xs.size(); i += 4)
+        {
+            __m128 x = _mm_loadu_ps(xs.data() + i);
+            __m128 y = _mm_loadu_ps(ys.data() + i);
+            __m128 z = _mm_loadu_ps(zs.data() + i);
+
+            // A sphere is outside as soon as it's entirely behind any one of the planes.
+            __m128 neg_radius =
+                _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radii.data() + i));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (auto const& [px, py, pz, pw] : planes)
+            {
+                __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, px), _mm_mul_ps(y, py)),
+                                         _mm_add_ps(_mm_mul_ps(z, pz), pw));
+                inside      = _mm_and_ps(inside, _mm_cmpge_ps(dist, neg_radius));
+            }
+
+            append_visible(_mm_movemask_ps(inside), i, visible);
+        }
+#else
+        cull_spheres_scalar(spheres, frustum, visible);
+#endif
+    }
+
+    void cull_spheres_scalar(SphereSet const& spheres,
+                             Frustum const& frustum,
+                             std::pmr::vector<std::uint32_t>& visible)
+    {
+        visible.clear();
+
+        auto xs    = spheres.get_x();
+        auto ys    = spheres.get_y();
+        auto zs    = spheres.get_z();
+        auto radii = spheres.get_radius();
+
+        for (std::size_t i{0}; i < spheres.size(); ++i)
+        {
+            // Summed in the same order as the SIMD paths so both round the same way and
+            // agree on spheres that only just touch a plane.
+            auto outside = std::any_of(frustum.begin(), frustum.end(), [&](glm::vec4 p) {
+                return (p.x * xs[i] + p.y * ys[i]) + (p.z * zs[i] + p.w) < -radii[i];
+            });
+
+            if (!outside)
+            {
+                visible.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+    }
+
+    std::string_view get_simd_name()
+    {
+#if defined(CULLING_AVX)
+        return "AVX";
+#elif defined(CULLING_SSE)
+        return "SSE2";
+#else
+        return "scalar";
+#endif
+    }
+} // namespace culling
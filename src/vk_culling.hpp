@@ -0,0 +1,60 @@
+#pragma once
+
+// CPU frustum culling against bounding spheres. The spheres are stored as a structure of
+// arrays so the plane tests run on several of them at once: 8 at a time when the build
+// targets AVX (see VULKAN_INTRO_AVX), 4 at a time with SSE2, which every x64 target has,
+// and one at a time everywhere else.
+namespace culling
+{
+    // Left, right, bottom, top, near and far, in that order. Normals point inwards.
+    using Frustum = std::array<glm::vec4, 6>;
+
+    // Planes are normalised so they can be used for sphere tests.
+    Frustum extract_frustum_planes(glm::mat4 const& view_proj);
+
+    // Moves a sphere (centre in xyz, radius in w) by transform. Non-uniform scales are
+    // handled conservatively by scaling the radius by the largest axis.
+    glm::vec4 transform_sphere(glm::mat4 const& transform, glm::vec4 sphere);
+
+    class SphereSet
+    {
+    public:
+        // The arrays are always padded to a multiple of this with spheres that can never
+        // be visible, so the SIMD loops don't need a scalar tail.
+        static constexpr std::size_t lane_count{8};
+
+        void clear();
+        void reserve(std::size_t count);
+        void push_back(glm::vec4 sphere);
+
+        std::size_t size() const;
+
+        // Include the padding.
+        std::span<float const> get_x() const;
+        std::span<float const> get_y() const;
+        std::span<float const> get_z() const;
+        std::span<float const> get_radius() const;
+
+    private:
+        std::vector<float> m_x;
+        std::vector<float> m_y;
+        std::vector<float> m_z;
+        std::vector<float> m_radius;
+        std::size_t m_size{0};
+    };
+
+    // Replaces the contents of visible with the indices of the spheres that intersect the
+    // frustum, in increasing order.
+    void cull_spheres(SphereSet const& spheres,
+                      Frustum const& frustum,
+                      std::pmr::vector<std::uint32_t>& visible);
+
+    // Same as cull_spheres but always tests one sphere at a time. Mostly useful as a
+    // reference for the SIMD paths.
+    void cull_spheres_scalar(SphereSet const& spheres,
+                             Frustum const& frustum,
+                             std::pmr::vector<std::uint32_t>& visible);
+
+    // Name of the instruction set cull_spheres was built with.
+    std::string_view get_simd_name();
+} // namespace culling
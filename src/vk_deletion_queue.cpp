@@ -0,0 +1,92 @@
+#include "vk_deletion_queue.hpp"
+
+void DeletionQueue::init(VmaAllocator allocator)
+{
+    m_allocator = allocator;
+}
+
+void DeletionQueue::push(vk_types::AllocatedBuffer const& buffer,
+                         std::uint64_t retire_value)
+{
+    push(m_buffers, vk_types::AllocatedBuffer{buffer}, retire_value);
+}
+
+void DeletionQueue::push(vk_types::AllocatedImage const& image,
+                         std::uint64_t retire_value)
+{
+    push(m_images, vk_types::AllocatedImage{image}, retire_value);
+}
+
+void DeletionQueue::push(vk::raii::ImageView&& view, std::uint64_t retire_value)
+{
+    push(m_image_views, std::move(view), retire_value);
+}
+
+void DeletionQueue::push(vk::raii::Framebuffer&& framebuffer, std::uint64_t retire_value)
+{
+    push(m_framebuffers, std::move(framebuffer), retire_value);
+}
+
+void DeletionQueue::push(vk::raii::SwapchainKHR&& swapchain, std::uint64_t retire_value)
+{
+    push(m_swapchains, std::move(swapchain), retire_value);
+}
+
+void DeletionQueue::flush(std::uint64_t completed_value)
+{
+    auto release = [](auto& handle) {
+        handle = nullptr;
+    };
+
+    flush(m_framebuffers, completed_value, release);
+    flush(m_image_views, completed_value, release);
+    flush(m_swapchains, completed_value, release);
+    flush(m_images, completed_value, [this](vk_types::AllocatedImage const& image) {
+        vmaDestroyImage(m_allocator, image.image, image.allocation);
+    });
+    flush(m_buffers, completed_value, [this](vk_types::AllocatedBuffer const& buffer) {
+        vmaDestroyBuffer(m_allocator, buffer.buffer, buffer.allocation);
+    });
+}
+
+void DeletionQueue::flush_all()
+{
+    flush(at_shutdown);
+}
+
+template<typename T>
+void DeletionQueue::push(Batch<T>& batch, T&& handle, std::uint64_t retire_value)
+{
+    batch.handles.push_back(std::move(handle));
+    batch.retire_values.push_back(retire_value);
+}
+
+template<typename T, typename Destroy>
+void DeletionQueue::flush(Batch<T>& batch,
+                          std::uint64_t completed_value,
+                          Destroy&& destroy)
+{
+    // Compact the survivors towards the front in place. Retire values mostly arrive in
+    // order, but resources that live until shutdown sit in the same arrays as ones that
+    // are retired every few frames, so this can't just pop from the front.
+    std::size_t kept{0};
+    for (std::size_t i{0}; i < batch.handles.size(); ++i)
+    {
+        if (batch.retire_values[i] <= completed_value)
+        {
+            destroy(batch.handles[i]);
+            continue;
+        }
+
+        if (kept != i)
+        {
+            batch.handles[kept]       = std::move(batch.handles[i]);
+            batch.retire_values[kept] = batch.retire_values[i];
+        }
+        ++kept;
+    }
+
+    batch.handles.erase(batch.handles.begin() + static_cast<std::ptrdiff_t>(kept),
+                        batch.handles.end());
+    batch.retire_values.resize(kept);
+}
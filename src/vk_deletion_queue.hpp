@@ -0,0 +1,55 @@
+#pragma once
+
+#include "vk_types.hpp"
+
+// Defers the destruction of GPU resources until the GPU is done with them. Instead of a
+// closure per entry, handles are kept in flat arrays by type, each stamped with the
+// value after which it's safe to free. Once the arrays have grown to their working size,
+// retiring a resource never touches the heap.
+//
+// What the values count is up to the owner (frames, timeline values).
+class DeletionQueue
+{
+public:
+    // Resources that should only go away when the queue is flushed for good.
+    static constexpr std::uint64_t at_shutdown{std::numeric_limits<std::uint64_t>::max()};
+
+    void init(VmaAllocator allocator);
+
+    void push(vk_types::AllocatedBuffer const& buffer, std::uint64_t retire_value);
+    void push(vk_types::AllocatedImage const& image, std::uint64_t retire_value);
+    void push(vk::raii::ImageView&& view, std::uint64_t retire_value);
+    void push(vk::raii::Framebuffer&& framebuffer, std::uint64_t retire_value);
+    void push(vk::raii::SwapchainKHR&& swapchain, std::uint64_t retire_value);
+
+    // Destroys everything whose retire value is at most completed_value. Anything that
+    // refers to another resource goes before it, so framebuffers and views are destroyed
+    // before the images and swapchains they were created from.
+    void flush(std::uint64_t completed_value);
+
+    // Destroys everything, including what was pushed with at_shutdown. Only call this
+    // once the device is idle.
+    void flush_all();
+
+private:
+    template<typename T>
+    struct Batch
+    {
+        std::vector<T> handles;
+        std::vector<std::uint64_t> retire_values;
+    };
+
+    template<typename T>
+    static void push(Batch<T>& batch, T&& handle, std::uint64_t retire_value);
+
+    template<typename T, typename Destroy>
+    static void flush(Batch<T>& batch, std::uint64_t completed_value, Destroy&& destroy);
+
+    VmaAllocator m_allocator{nullptr};
+
+    Batch<vk::raii::Framebuffer> m_framebuffers;
+    Batch<vk::raii::ImageView> m_image_views;
+    Batch<vk::raii::SwapchainKHR> m_swapchains;
+    Batch<vk_types::AllocatedImage> m_images;
+    Batch<vk_types::AllocatedBuffer> m_buffers;
+};
@@ -0,0 +1,92 @@
+#include "vk_descriptors.hpp"
+
+#include <zeus/assert.hpp>
+
+DescriptorLayoutBuilder&
+DescriptorLayoutBuilder::add_binding(std::uint32_t binding,
+                                     vk::DescriptorType type,
+                                     vk::ShaderStageFlags stages,
+                                     std::uint32_t count,
+                                     vk::DescriptorBindingFlags flags)
+{
+    m_bindings.push_back(vk::DescriptorSetLayoutBinding{.binding         = binding,
+                                                        .descriptorType  = type,
+                                                        .descriptorCount = count,
+                                                        .stageFlags      = stages});
+    m_flags.push_back(flags);
+    return *this;
+}
+
+vk::raii::DescriptorSetLayout
+DescriptorLayoutBuilder::build(vk::raii::Device const& device) const
+{
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo flags_info{
+        .bindingCount  = static_cast<std::uint32_t>(m_flags.size()),
+        .pBindingFlags = m_flags.data()};
+
+    bool has_flags = std::any_of(m_flags.begin(), m_flags.end(), [](auto flags) {
+        return static_cast<bool>(flags);
+    });
+
+    vk::DescriptorSetLayoutCreateInfo layout_info{
+        .pNext        = has_flags ? &flags_info : nullptr,
+        .bindingCount = static_cast<std::uint32_t>(m_bindings.size()),
+        .pBindings    = m_bindings.data()};
+    return vk::raii::DescriptorSetLayout{device, layout_info};
+}
+
+void DescriptorAllocator::init(vk::raii::Device const& device,
+                               std::uint32_t sets_per_pool,
+                               std::vector<PoolRatio> ratios)
+{
+    ASSERT(sets_per_pool > 0);
+
+    m_device        = &device;
+    m_sets_per_pool = sets_per_pool;
+    m_ratios        = std::move(ratios);
+    add_pool();
+}
+
+vk::DescriptorSet DescriptorAllocator::allocate(vk::DescriptorSetLayout layout)
+{
+    ASSERT(m_device != nullptr);
+
+    auto try_allocate = [this, layout]() {
+        vk::DescriptorSetAllocateInfo alloc_info{.descriptorPool     = *m_pools.back(),
+                                                 .descriptorSetCount = 1,
+                                                 .pSetLayouts        = &layout};
+        return vk::Device{**m_device}.allocateDescriptorSets(alloc_info).front();
+    };
+
+    try
+    {
+        return try_allocate();
+    }
+    catch (vk::OutOfPoolMemoryError const&)
+    {}
+    catch (vk::FragmentedPoolError const&)
+    {}
+
+    // The current pool is full. A set that doesn't fit in an empty pool either is a bug,
+    // so let that one throw.
+    add_pool();
+    return try_allocate();
+}
+
+void DescriptorAllocator::add_pool()
+{
+    std::vector<vk::DescriptorPoolSize> pool_sizes;
+    pool_sizes.reserve(m_ratios.size());
+    for (auto const& [type, ratio] : m_ratios)
+    {
+        auto count = static_cast<std::uint32_t>(std::ceil(ratio * m_sets_per_pool));
+        pool_sizes.push_back(vk::DescriptorPoolSize{.type            = type,
+                                                    .descriptorCount = count});
+    }
+
+    vk::DescriptorPoolCreateInfo pool_info{
+        .maxSets       = m_sets_per_pool,
+        .poolSizeCount = static_cast<std::uint32_t>(pool_sizes.size()),
+        .pPoolSizes    = pool_sizes.data()};
+    m_pools.emplace_back(*m_device, pool_info);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+// Collects bindings and builds a descriptor set layout out of them. Binding flags are
+// only chained into the layout if at least one binding has any.
+class DescriptorLayoutBuilder
+{
+public:
+    DescriptorLayoutBuilder& add_binding(std::uint32_t binding,
+                                         vk::DescriptorType type,
+                                         vk::ShaderStageFlags stages,
+                                         std::uint32_t count             = 1,
+                                         vk::DescriptorBindingFlags flags = {});
+
+    vk::raii::DescriptorSetLayout build(vk::raii::Device const& device) const;
+
+private:
+    std::vector<vk::DescriptorSetLayoutBinding> m_bindings;
+    std::vector<vk::DescriptorBindingFlags> m_flags;
+};
+
+// Hands out descriptor sets from a list of pools, adding a new pool whenever the current
+// one runs out. Sets are never freed individually: they all live until the allocator is
+// destroyed, which is what lets the pools skip eFreeDescriptorSet.
+class DescriptorAllocator
+{
+public:
+    // How many descriptors of a type each pool gets, per set it can hold.
+    struct PoolRatio
+    {
+        vk::DescriptorType type;
+        float ratio;
+    };
+
+    void init(vk::raii::Device const& device,
+              std::uint32_t sets_per_pool,
+              std::vector<PoolRatio> ratios);
+
+    vk::DescriptorSet allocate(vk::DescriptorSetLayout layout);
+
+private:
+    void add_pool();
+
+    vk::raii::Device const* m_device{nullptr};
+    std::uint32_t m_sets_per_pool{0};
+    std::vector<PoolRatio> m_ratios;
+
+    // The last pool is the one sets are allocated from.
+    std::vector<vk::raii::DescriptorPool> m_pools;
+};
@@ -1,5 +1,165 @@
 #include "vk_mesh.hpp"
 #include "shaders/bindings.h"
+#include "vk_mesh_cache.hpp"
+#include "vk_mesh_optimiser.hpp"
+
+// Maps a unit vector onto the octahedron |x| + |y| + |z| = 1 and unfolds the lower half
+// over the upper one, which leaves a point in [-1, 1]^2. The matching decode lives in
+// shaders/vertex_input.glsl.
+static glm::vec2 octahedral_encode(glm::vec3 n)
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p{n.x, n.y};
+    if (n.z < 0.0f)
+    {
+        glm::vec2 sign{p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f};
+        p = (1.0f - glm::abs(glm::vec2{p.y, p.x})) * sign;
+    }
+
+    return p;
+}
+
+static glm::vec3 octahedral_decode(glm::vec2 p)
+{
+    glm::vec3 n{p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y)};
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+namespace vertex_packing
+{
+    glm::u16vec4 pack_position(glm::vec3 position)
+    {
+        return glm::packHalf(glm::vec4{position, 1.0f});
+    }
+
+    glm::vec3 unpack_position(glm::u16vec4 position)
+    {
+        return glm::vec3{glm::unpackHalf(position)};
+    }
+
+    std::uint32_t pack_normal(glm::vec3 normal)
+    {
+        return glm::packSnorm2x16(octahedral_encode(normal));
+    }
+
+    glm::vec3 unpack_normal(std::uint32_t normal)
+    {
+        return octahedral_decode(glm::unpackSnorm2x16(normal));
+    }
+
+    std::uint32_t pack_colour(glm::vec3 colour)
+    {
+        return glm::packUnorm4x8(glm::vec4{colour, 1.0f});
+    }
+
+    glm::vec3 unpack_colour(std::uint32_t colour)
+    {
+        return glm::vec3{glm::unpackUnorm4x8(colour)};
+    }
+
+    std::uint32_t pack_uv(glm::vec2 uv)
+    {
+        return glm::packUnorm2x16(uv);
+    }
+
+    glm::vec2 unpack_uv(std::uint32_t uv)
+    {
+        return glm::unpackUnorm2x16(uv);
+    }
+} // namespace vertex_packing
+
+#if defined(VULKAN_INTRO_PACKED_VERTICES)
+glm::vec3 Vertex::get_position() const
+{
+    return vertex_packing::unpack_position(position);
+}
+
+glm::vec3 Vertex::get_normal() const
+{
+    return vertex_packing::unpack_normal(normal);
+}
+
+glm::vec3 Vertex::get_colour() const
+{
+    return vertex_packing::unpack_colour(colour);
+}
+
+glm::vec2 Vertex::get_uv() const
+{
+    return vertex_packing::unpack_uv(uv);
+}
+
+Vertex make_vertex(glm::vec3 position, glm::vec3 normal, glm::vec3 colour, glm::vec2 uv)
+{
+    // The colour is clamped to [0, 1] by the packing, which is what the rasteriser would
+    // have done to it anyway. The UVs get the same treatment, see the note on Vertex.
+    return Vertex{.position = vertex_packing::pack_position(position),
+                  .normal   = vertex_packing::pack_normal(normal),
+                  .colour   = vertex_packing::pack_colour(colour),
+                  .uv       = vertex_packing::pack_uv(uv)};
+}
+
+VertexInputDescription Vertex::get_vertex_description()
+{
+    vk::VertexInputBindingDescription main_binding{.binding = 0,
+                                                   .stride  = sizeof(Vertex),
+                                                   .inputRate =
+                                                       vk::VertexInputRate::eVertex};
+
+    vk::VertexInputAttributeDescription position_attr{
+        .location = VERTEX_ATTRIBUTE_LOCATION,
+        .binding  = 0,
+        .format   = vk::Format::eR16G16B16A16Sfloat,
+        .offset   = offsetof(Vertex, position)};
+
+    vk::VertexInputAttributeDescription normal_attr{.location = NORMAL_ATTRIBUTE_LOCATION,
+                                                    .binding  = 0,
+                                                    .format = vk::Format::eR16G16Snorm,
+                                                    .offset = offsetof(Vertex, normal)};
+
+    vk::VertexInputAttributeDescription colour_attr{.location = COLOUR_ATTRIBUTE_LOCATION,
+                                                    .binding  = 0,
+                                                    .format = vk::Format::eR8G8B8A8Unorm,
+                                                    .offset = offsetof(Vertex, colour)};
+
+    vk::VertexInputAttributeDescription uv_attr{.location = UV_ATTRIBUTE_LOCATION,
+                                                .binding  = 0,
+                                                .format   = vk::Format::eR16G16Unorm,
+                                                .offset   = offsetof(Vertex, uv)};
+
+    return VertexInputDescription{
+        .bindings   = {main_binding},
+        .attributes = {position_attr, normal_attr, colour_attr, uv_attr}
+    };
+}
+#else
+glm::vec3 Vertex::get_position() const
+{
+    return position;
+}
+
+glm::vec3 Vertex::get_normal() const
+{
+    return normal;
+}
+
+glm::vec3 Vertex::get_colour() const
+{
+    return colour;
+}
+
+glm::vec2 Vertex::get_uv() const
+{
+    return uv;
+}
+
+Vertex make_vertex(glm::vec3 position, glm::vec3 normal, glm::vec3 colour, glm::vec2 uv)
+{
+    return Vertex{.position = position, .normal = normal, .colour = colour, .uv = uv};
+}
 
 VertexInputDescription Vertex::get_vertex_description()
 {
@@ -27,21 +187,109 @@ VertexInputDescription Vertex::get_vertex_description()
                                                         vk::Format::eR32G32B32Sfloat,
                                                     .offset = offsetof(Vertex, colour)};
 
+    vk::VertexInputAttributeDescription uv_attr{.location = UV_ATTRIBUTE_LOCATION,
+                                                .binding  = 0,
+                                                .format   = vk::Format::eR32G32Sfloat,
+                                                .offset   = offsetof(Vertex, uv)};
+
     return VertexInputDescription{
         .bindings   = {main_binding},
-        .attributes = {position_attr, normal_attr, colour_attr}
+        .attributes = {position_attr, normal_attr, colour_attr, uv_attr}
     };
 }
+#endif
+
+bool Model::load_from_file(std::filesystem::path const& path,
+                           ThreadPool* pool,
+                           bool optimise,
+                           bool use_cache)
+{
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+
+    bool from_cache = use_cache && load_from_cache(path, optimise);
+    if (!from_cache && !import_from_source(path, pool, optimise, use_cache))
+    {
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start);
+    fmt::print("loaded {} ({} meshes, {} vertices at {} bytes, {} indices) from {} in "
+               "{:.3f} ms ({} threads)\n",
+               path.filename().string(),
+               meshes.size(),
+               m_vertex_data.size(),
+               sizeof(Vertex),
+               m_index_data.size(),
+               from_cache ? "cache" : "source",
+               elapsed.count(),
+               pool ? pool->size() + 1 : 1);
+
+    return true;
+}
 
-bool Model::load_from_file(std::filesystem::path const& path)
+bool Model::load_from_file(std::string const& filename,
+                           ThreadPool* pool,
+                           bool optimise,
+                           bool use_cache)
 {
-    return load_from_file(path.string());
+    return load_from_file(std::filesystem::path{filename}, pool, optimise, use_cache);
+}
+
+std::span<Vertex const> Model::get_vertices() const
+{
+    return m_vertex_data;
+}
+
+std::span<std::uint32_t const> Model::get_indices() const
+{
+    return m_index_data;
+}
+
+void Model::release_geometry()
+{
+    // Swapping with empty vectors is the only way to be sure the memory is returned,
+    // since clear keeps the capacity around.
+    std::vector<Vertex>{}.swap(m_vertices);
+    std::vector<std::uint32_t>{}.swap(m_indices);
+    m_cache_file.close();
+
+    m_vertex_data = {};
+    m_index_data  = {};
 }
 
-bool Model::load_from_file(std::string const& filename)
+static mesh_cache::CacheFlags get_cache_flags(bool optimise)
+{
+    return optimise ? mesh_cache::CacheFlags::eOptimised : mesh_cache::CacheFlags::eNone;
+}
+
+bool Model::load_from_cache(std::filesystem::path const& path, bool optimise)
+{
+    auto geometry = mesh_cache::read(path, get_cache_flags(optimise), m_cache_file);
+    if (!geometry)
+    {
+        return false;
+    }
+
+    // The mesh table is tiny, so it's fine to copy it. The vertex and index blobs are
+    // used straight out of the mapping.
+    meshes.assign(geometry->meshes.begin(), geometry->meshes.end());
+    materials     = std::move(geometry->materials);
+    m_vertex_data = geometry->vertices;
+    m_index_data  = geometry->indices;
+    return true;
+}
+
+bool Model::import_from_source(std::filesystem::path const& path,
+                               ThreadPool* pool,
+                               bool optimise,
+                               bool use_cache)
 {
     static constexpr std::uint32_t flags = aiProcess_Triangulate | aiProcess_FlipUVs;
 
+    auto filename = path.string();
+
     Assimp::Importer import;
     const aiScene* scene = import.ReadFile(filename, flags);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
@@ -51,29 +299,205 @@ bool Model::load_from_file(std::string const& filename)
         return false;
     }
 
-    process_node(scene->mRootNode, scene);
+    // Walk the node tree first to fix the order of the meshes, then lay out where each
+    // one goes in the packed arrays. Once that's done every mesh writes to its own
+    // disjoint range, so they can all be converted at the same time.
+    std::vector<aiMesh const*> import_order;
+    process_node(scene->mRootNode, scene, import_order);
+    process_materials(scene);
+
+    meshes.clear();
+    meshes.reserve(import_order.size());
+
+    std::uint32_t vertex_count{0};
+    std::uint32_t index_count{0};
+    for (auto mesh : import_order)
+    {
+        Mesh range{.first_index    = index_count,
+                   .vertex_offset  = static_cast<std::int32_t>(vertex_count),
+                   .vertex_count   = mesh->mNumVertices,
+                   .material_index = mesh->mMaterialIndex};
+
+        // After triangulation anything that is purely triangles has exactly three
+        // indices per face. Points and lines can survive it though, so fall back to
+        // counting for those.
+        if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+        {
+            range.index_count = mesh->mNumFaces * 3;
+        }
+        else
+        {
+            for (std::uint32_t i{0}; i < mesh->mNumFaces; ++i)
+            {
+                range.index_count += mesh->mFaces[i].mNumIndices;
+            }
+        }
+
+        vertex_count += range.vertex_count;
+        index_count += range.index_count;
+        meshes.push_back(range);
+    }
+
+    m_vertices.resize(vertex_count);
+    m_indices.resize(index_count);
+
+    auto convert = [this, &import_order](std::size_t i) {
+        process_mesh(import_order[i], meshes[i]);
+    };
+
+    if (pool != nullptr)
+    {
+        pool->parallel_for(import_order.size(), convert);
+    }
+    else
+    {
+        for (std::size_t i{0}; i < import_order.size(); ++i)
+        {
+            convert(i);
+        }
+    }
+
+    // Everything we need has been copied out of the scene by now, and it's at least as
+    // big as the packed geometry, so drop it before the optimiser makes its own copies.
+    import_order.clear();
+    import.FreeScene();
+
+    if (optimise)
+    {
+        optimise_meshes(path.filename().string(), pool);
+    }
+
+    m_vertex_data = m_vertices;
+    m_index_data  = m_indices;
+
+    if (!use_cache)
+    {
+        return true;
+    }
+
+    mesh_cache::write(path,
+                      get_cache_flags(optimise),
+                      mesh_cache::CachedGeometry{.meshes    = meshes,
+                                                 .vertices  = m_vertex_data,
+                                                 .indices   = m_index_data,
+                                                 .materials = materials});
     return true;
 }
 
-void Model::process_node(aiNode* node, aiScene const* scene)
+void Model::optimise_meshes(std::string const& name, ThreadPool* pool)
+{
+    std::vector<mesh_optimiser::Result> results(meshes.size());
+
+    auto optimise = [this, &results](std::size_t i) {
+        auto& mesh = meshes[i];
+        auto vertices =
+            std::span{m_vertices}.subspan(mesh.vertex_offset, mesh.vertex_count);
+        auto indices = std::span{m_indices}.subspan(mesh.first_index, mesh.index_count);
+
+        results[i] = mesh_optimiser::optimise(vertices, indices);
+    };
+
+    if (pool != nullptr)
+    {
+        pool->parallel_for(meshes.size(), optimise);
+    }
+    else
+    {
+        for (std::size_t i{0}; i < meshes.size(); ++i)
+        {
+            optimise(i);
+        }
+    }
+
+    // Report the totals for the whole model, weighting each mesh by how much it
+    // contributes: triangles for ACMR, vertices for ATVR and overfetch.
+    mesh_optimiser::Statistics before;
+    mesh_optimiser::Statistics after;
+    float triangles{0.0f};
+    float vertices_before{0.0f};
+    float vertices_after{0.0f};
+    for (std::size_t i{0}; i < meshes.size(); ++i)
+    {
+        auto const& result  = results[i];
+        auto mesh_triangles = static_cast<float>(meshes[i].index_count / 3);
+        auto mesh_before    = static_cast<float>(meshes[i].vertex_count);
+        auto mesh_after     = static_cast<float>(result.vertex_count);
+
+        before.acmr += result.before.acmr * mesh_triangles;
+        after.acmr += result.after.acmr * mesh_triangles;
+        before.atvr += result.before.atvr * mesh_before;
+        after.atvr += result.after.atvr * mesh_after;
+        before.overfetch += result.before.overfetch * mesh_before;
+        after.overfetch += result.after.overfetch * mesh_after;
+
+        triangles += mesh_triangles;
+        vertices_before += mesh_before;
+        vertices_after += mesh_after;
+    }
+
+    // Deduplication leaves a gap at the end of each mesh's vertex range, so slide
+    // everything down to pack the vertices back together. Ranges only ever move towards
+    // the front, so copying forwards is safe.
+    std::uint32_t vertex_count{0};
+    for (std::size_t i{0}; i < meshes.size(); ++i)
+    {
+        auto& mesh  = meshes[i];
+        auto source = m_vertices.begin() + mesh.vertex_offset;
+        std::copy(source,
+                  source + results[i].vertex_count,
+                  m_vertices.begin() + vertex_count);
+
+        mesh.vertex_offset = static_cast<std::int32_t>(vertex_count);
+        mesh.vertex_count  = results[i].vertex_count;
+        vertex_count += mesh.vertex_count;
+    }
+
+    auto average = [](float total, float weight) {
+        return weight > 0.0f ? total / weight : 0.0f;
+    };
+
+    fmt::print("optimised {}: vertices {} -> {}, ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> "
+               "{:.3f}, overfetch {:.3f} -> {:.3f}\n",
+               name,
+               m_vertices.size(),
+               vertex_count,
+               average(before.acmr, triangles),
+               average(after.acmr, triangles),
+               average(before.atvr, vertices_before),
+               average(after.atvr, vertices_after),
+               average(before.overfetch, vertices_before),
+               average(after.overfetch, vertices_after));
+
+    m_vertices.resize(vertex_count);
+}
+
+void Model::process_node(aiNode* node,
+                         aiScene const* scene,
+                         std::vector<aiMesh const*>& import_order)
 {
     for (std::uint32_t i{0}; i < node->mNumMeshes; ++i)
     {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes.push_back(process_mesh(mesh, scene));
+        import_order.push_back(scene->mMeshes[node->mMeshes[i]]);
     }
 
     for (std::uint32_t i{0}; i < node->mNumChildren; ++i)
     {
-        process_node(node->mChildren[i], scene);
+        process_node(node->mChildren[i], scene, import_order);
     }
 }
 
-Mesh Model::process_mesh(aiMesh* mesh, aiScene const*)
+void Model::process_mesh(aiMesh const* mesh, Mesh& range)
 {
-    // Ignore textures and any extra data for now. We'll worry about it later.
-    std::vector<Vertex> vertices;
-    std::vector<std::uint32_t> indices;
+    // Only the first set of texture coordinates is used, and meshes without any just get
+    // zeros.
+    auto vertices =
+        std::span{m_vertices}.subspan(range.vertex_offset, range.vertex_count);
+    auto indices = std::span{m_indices}.subspan(range.first_index, range.index_count);
+
+    // Track the AABB as we go so only the radius of the bounding sphere needs a second
+    // pass over the positions.
+    glm::vec3 min_corner{std::numeric_limits<float>::max()};
+    glm::vec3 max_corner{std::numeric_limits<float>::lowest()};
 
     for (std::uint32_t i{0}; i < mesh->mNumVertices; ++i)
     {
@@ -87,18 +511,59 @@ Mesh Model::process_mesh(aiMesh* mesh, aiScene const*)
         normal.y = mesh->mNormals[i].y;
         normal.z = mesh->mNormals[i].z;
 
-        vertices.push_back(
-            Vertex{.position = position, .normal = normal, .colour = normal});
+        glm::vec2 uv{0.0f};
+        if (mesh->HasTextureCoords(0))
+        {
+            uv.x = mesh->mTextureCoords[0][i].x;
+            uv.y = mesh->mTextureCoords[0][i].y;
+        }
+
+        vertices[i] = make_vertex(position, normal, normal, uv);
+
+        min_corner = glm::min(min_corner, position);
+        max_corner = glm::max(max_corner, position);
     }
 
+    std::size_t index{0};
     for (std::uint32_t i{0}; i < mesh->mNumFaces; ++i)
     {
-        aiFace face = mesh->mFaces[i];
+        aiFace const& face = mesh->mFaces[i];
         for (std::uint32_t j{0}; j < face.mNumIndices; ++j)
         {
-            indices.push_back(face.mIndices[j]);
+            indices[index++] = face.mIndices[j];
         }
     }
 
-    return Mesh{.vertices = vertices, .indices = indices};
+    // Centre the bounding sphere on the AABB. It's not the tightest fit, but it's cheap
+    // and good enough for culling.
+    glm::vec3 centre = (min_corner + max_corner) * 0.5f;
+    float radius{0.0f};
+    for (auto const& vertex : vertices)
+    {
+        radius = std::max(radius, glm::distance(centre, vertex.get_position()));
+    }
+    range.bounding_sphere = glm::vec4{centre, radius};
+    range.aabb_min        = min_corner;
+    range.aabb_max        = max_corner;
+}
+
+void Model::process_materials(aiScene const* scene)
+{
+    materials.clear();
+    materials.resize(scene->mNumMaterials);
+
+    for (std::uint32_t i{0}; i < scene->mNumMaterials; ++i)
+    {
+        auto material = scene->mMaterials[i];
+        if (material->GetTextureCount(aiTextureType_DIFFUSE) == 0)
+        {
+            continue;
+        }
+
+        aiString path;
+        if (material->GetTexture(aiTextureType_DIFFUSE, 0, &path) == AI_SUCCESS)
+        {
+            materials[i].diffuse_texture = path.C_Str();
+        }
+    }
 }
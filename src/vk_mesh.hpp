@@ -1,5 +1,7 @@
 #pragma once
 
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
 #include "vk_types.hpp"
 
 struct VertexInputDescription
@@ -10,38 +12,211 @@ struct VertexInputDescription
     vk::PipelineVertexInputStateCreateFlags flags;
 };
 
+// Encoders for the packed vertex layout. They're built whichever layout is in use, so
+// they can be tested (and used for other data) either way.
+//
+// Going through an encoder and back, the error per component is at most 2^-11 relative
+// for positions, 0.5/255 for colours and 0.5/65535 for UVs. Normals come back within
+// 1e-4 of the original unit vector. The packed_vertices test checks all of these.
+namespace vertex_packing
+{
+    // Half-float xyz, with w fixed to 1.
+    glm::u16vec4 pack_position(glm::vec3 position);
+    glm::vec3 unpack_position(glm::u16vec4 position);
+
+    // Octahedral-encoded unit vector as two snorm16s.
+    std::uint32_t pack_normal(glm::vec3 normal);
+    glm::vec3 unpack_normal(std::uint32_t normal);
+
+    // RGBA8 unorm, with alpha fixed to 1. Components are clamped to [0, 1].
+    std::uint32_t pack_colour(glm::vec3 colour);
+    glm::vec3 unpack_colour(std::uint32_t colour);
+
+    // Two unorm16s. Components are clamped to [0, 1].
+    std::uint32_t pack_uv(glm::vec2 uv);
+    glm::vec2 unpack_uv(std::uint32_t uv);
+} // namespace vertex_packing
+
+// The vertex layout is picked at compile time with VULKAN_INTRO_PACKED_VERTICES. The
+// same define is passed to the shaders, and vertex_input.glsl decodes whichever layout
+// was selected. Either way, vertices should only be built with make_vertex and read back
+// through the getters so the rest of the code doesn't care which one is in use.
+#if defined(VULKAN_INTRO_PACKED_VERTICES)
+// 20 bytes per vertex:
+// * position: half-float xyz, with w fixed to 1. Kept as four u16s rather than a single
+//   u64 so the struct only needs 4 byte alignment and doesn't get padded out to 24.
+// * normal: octahedral-encoded unit vector as two snorm16s.
+// * colour: RGBA8 unorm.
+// * uv: two unorm16s. Coordinates are clamped to [0, 1], which is all atlas-style models
+//   need and gives far more precision than halves would across a large texture. Models
+//   that rely on wrapping need the float layout.
+//
+// Each member goes through the matching function in vertex_packing, so the error bounds
+// documented there apply to make_vertex and the getters as well.
+struct Vertex
+{
+    glm::u16vec4 position;
+    std::uint32_t normal;
+    std::uint32_t colour;
+    std::uint32_t uv;
+
+    glm::vec3 get_position() const;
+    glm::vec3 get_normal() const;
+    glm::vec3 get_colour() const;
+    glm::vec2 get_uv() const;
+
+    static VertexInputDescription get_vertex_description();
+};
+#else
 struct Vertex
 {
     glm::vec3 position;
     glm::vec3 normal;
     glm::vec3 colour;
+    glm::vec2 uv;
+
+    glm::vec3 get_position() const;
+    glm::vec3 get_normal() const;
+    glm::vec3 get_colour() const;
+    glm::vec2 get_uv() const;
 
     static VertexInputDescription get_vertex_description();
 };
+#endif
 
+Vertex make_vertex(glm::vec3 position,
+                   glm::vec3 normal,
+                   glm::vec3 colour,
+                   glm::vec2 uv);
+
+// Everything else comes from the scene data and the object buffer.
 struct MeshPushConstants
 {
-    glm::vec4 data;
-    glm::mat4 mvp;
+    std::uint32_t object_index;
+};
+
+// Instanced draws cover a run of objects that share a mesh, and therefore a texture.
+struct InstancedPushConstants
+{
+    std::uint32_t texture_index;
 };
 
+struct CullPushConstants
+{
+    std::array<glm::vec4, 6> frustum_planes;
+    std::uint32_t object_count;
+};
+
+// GPU-side copies of the scene used by the indirect path. The layout of these has to
+// match the structs in shaders/scene_data.glsl.
+struct GpuObjectData
+{
+    glm::mat4 model;
+    std::uint32_t mesh_index;
+    std::uint32_t texture_index;
+    std::uint32_t padding[2];
+};
+
+// Per-frame camera data. Has to match SceneBuffer in shaders/scene_uniforms.glsl.
+struct GpuSceneData
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 view_proj;
+};
+
+struct GpuMeshData
+{
+    std::uint32_t index_count;
+    std::uint32_t first_index;
+    std::int32_t vertex_offset;
+    std::uint32_t padding;
+    glm::vec4 bounding_sphere;
+};
+
+// A mesh is just a range inside the geometry of the model that owns it. Indices are
+// relative to the first vertex of the mesh, so they have to be drawn with vertex_offset.
 struct Mesh
 {
-    std::vector<Vertex> vertices;
-    std::vector<std::uint32_t> indices;
-    vk_types::AllocatedBuffer vertex_buffer;
-    vk_types::AllocatedBuffer index_buffer;
+    std::uint32_t first_index{0};
+    std::uint32_t index_count{0};
+    std::int32_t vertex_offset{0};
+    std::uint32_t vertex_count{0};
+
+    // Index into the materials of the model that owns the mesh.
+    std::uint32_t material_index{0};
+
+    // Both in model space. The sphere has its centre in xyz and its radius in w.
+    glm::vec4 bounding_sphere{0.0f};
+    glm::vec3 aabb_min{0.0f};
+    glm::vec3 aabb_max{0.0f};
+};
+
+// What the source file says about a material. Only the diffuse map is picked up for now,
+// as a path relative to the model file, and it's empty if the material doesn't have one.
+struct MaterialInfo
+{
+    std::string diffuse_texture;
 };
 
 class Model
 {
 public:
-    bool load_from_file(std::filesystem::path const& path);
-    bool load_from_file(std::string const& filename);
+    Model() = default;
+
+    // The geometry views may point into the model itself, so it can't be copied.
+    Model(Model const&)            = delete;
+    Model& operator=(Model const&) = delete;
+
+    // If a pool is given, the meshes in the file are converted in parallel on it. If
+    // optimise is set, each mesh also goes through the mesh optimiser before it's packed.
+    // Without use_cache the binary cache is neither read nor written, so the model is
+    // always imported from the source file.
+    bool load_from_file(std::filesystem::path const& path,
+                        ThreadPool* pool = nullptr,
+                        bool optimise    = false,
+                        bool use_cache   = true);
+    bool load_from_file(std::string const& filename,
+                        ThreadPool* pool = nullptr,
+                        bool optimise    = false,
+                        bool use_cache   = true);
+
+    // Geometry pool for the model: all meshes are packed back to back into a single
+    // vertex and index array, which are uploaded into one buffer each. Depending on how
+    // the model was loaded, these either view the imported data or the mapped cache.
+    std::span<Vertex const> get_vertices() const;
+    std::span<std::uint32_t const> get_indices() const;
+
+    // Frees the CPU copy of the geometry (or unmaps the cache), leaving only the meshes,
+    // materials and GPU buffers. The geometry views are empty afterwards.
+    void release_geometry();
 
     std::vector<Mesh> meshes;
+    std::vector<MaterialInfo> materials;
+    vk_types::AllocatedBuffer vertex_buffer;
+    vk_types::AllocatedBuffer index_buffer;
 
 private:
-    void process_node(aiNode* node, aiScene const* scene);
-    Mesh process_mesh(aiMesh* mesh, aiScene const* scene);
+    bool load_from_cache(std::filesystem::path const& path, bool optimise);
+    bool import_from_source(std::filesystem::path const& path,
+                            ThreadPool* pool,
+                            bool optimise,
+                            bool use_cache);
+    void optimise_meshes(std::string const& name, ThreadPool* pool);
+
+    void process_node(aiNode* node,
+                      aiScene const* scene,
+                      std::vector<aiMesh const*>& import_order);
+    void process_mesh(aiMesh const* mesh, Mesh& range);
+    void process_materials(aiScene const* scene);
+
+    // Only populated when the model had to be imported through Assimp.
+    std::vector<Vertex> m_vertices;
+    std::vector<std::uint32_t> m_indices;
+
+    // Only open when the model was loaded from its binary cache.
+    MappedFile m_cache_file;
+
+    std::span<Vertex const> m_vertex_data;
+    std::span<std::uint32_t const> m_index_data;
 };
@@ -0,0 +1,302 @@
+#include "vk_mesh_cache.hpp"
+
+namespace mesh_cache
+{
+    static constexpr std::uint32_t cache_magic{0x434d4956}; // "VIMC"
+    static constexpr std::uint32_t cache_version{4};
+    static constexpr std::size_t section_alignment{16};
+
+    struct Header
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t flags;
+        std::uint32_t padding;
+
+        // Key for the source file. The mtime is checked first, and the hash is only used
+        // when it differs (e.g. the file was copied or touched but not changed). A cache
+        // that passes on the hash gets the new mtime written back.
+        std::uint64_t source_size;
+        std::int64_t source_mtime;
+        std::uint64_t source_hash;
+
+        // Guards against the vertex or mesh layout changing under an old cache.
+        std::uint32_t vertex_stride;
+        std::uint32_t mesh_stride;
+
+        std::uint64_t vertex_count;
+        std::uint64_t index_count;
+        std::uint64_t mesh_count;
+        std::uint64_t material_count;
+
+        std::uint64_t vertex_offset;
+        std::uint64_t index_offset;
+        std::uint64_t mesh_offset;
+        std::uint64_t material_offset;
+    };
+
+    static std::size_t align_up(std::size_t value)
+    {
+        return (value + section_alignment - 1) & ~(section_alignment - 1);
+    }
+
+    static std::int64_t get_mtime(std::filesystem::path const& path)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(path, ec);
+        return ec ? 0 : time.time_since_epoch().count();
+    }
+
+    // 64-bit FNV-1a over the contents of the file.
+    static std::uint64_t hash_file(std::filesystem::path const& path)
+    {
+        std::uint64_t hash{0xcbf29ce484222325};
+
+        std::ifstream stream{path, std::ios::binary};
+        std::vector<char> buffer(1 << 20);
+        while (stream)
+        {
+            stream.read(buffer.data(), buffer.size());
+            auto count = static_cast<std::size_t>(stream.gcount());
+            for (std::size_t i{0}; i < count; ++i)
+            {
+                hash ^= static_cast<std::uint8_t>(buffer[i]);
+                hash *= 0x100000001b3;
+            }
+        }
+
+        return hash;
+    }
+
+    static std::optional<std::vector<MaterialInfo>>
+    read_materials(std::span<std::byte const> data, Header const& header)
+    {
+        if (header.material_offset % section_alignment != 0
+            || header.material_offset > data.size())
+        {
+            return {};
+        }
+
+        std::vector<MaterialInfo> materials;
+        materials.reserve(static_cast<std::size_t>(header.material_count));
+
+        auto remaining = data.subspan(static_cast<std::size_t>(header.material_offset));
+        for (std::uint64_t i{0}; i < header.material_count; ++i)
+        {
+            std::uint32_t length;
+            if (remaining.size() < sizeof(length))
+            {
+                return {};
+            }
+            std::memcpy(&length, remaining.data(), sizeof(length));
+            remaining = remaining.subspan(sizeof(length));
+
+            if (remaining.size() < length)
+            {
+                return {};
+            }
+
+            auto chars = reinterpret_cast<char const*>(remaining.data());
+            materials.push_back(MaterialInfo{.diffuse_texture = {chars, length}});
+            remaining = remaining.subspan(length);
+        }
+
+        return materials;
+    }
+
+    // Only touches the mtime in the header, which is all that changes when the source
+    // was touched but not modified. The rest of the file is left as is, so this is safe
+    // while the cache is mapped.
+    static void write_source_mtime(std::filesystem::path const& cache_path,
+                                   std::int64_t mtime)
+    {
+        std::fstream stream{cache_path, std::ios::binary | std::ios::in | std::ios::out};
+        if (stream.is_open())
+        {
+            stream.seekp(offsetof(Header, source_mtime));
+            stream.write(reinterpret_cast<char const*>(&mtime), sizeof(mtime));
+        }
+
+        if (!stream.is_open() || !stream.good())
+        {
+            fmt::print("warning: unable to update mesh cache {}\n", cache_path.string());
+        }
+    }
+
+    std::filesystem::path get_cache_path(std::filesystem::path const& source)
+    {
+        auto path = source;
+        path += ".meshcache";
+        return path;
+    }
+
+    std::optional<CachedGeometry> read(std::filesystem::path const& source,
+                                       CacheFlags flags,
+                                       MappedFile& file)
+    {
+        namespace fs = std::filesystem;
+
+        std::error_code ec;
+        auto cache_path = get_cache_path(source);
+        if (!fs::exists(cache_path, ec) || !file.open(cache_path))
+        {
+            return {};
+        }
+
+        auto data = file.data();
+        auto reject = [&file]() -> std::optional<CachedGeometry> {
+            file.close();
+            return {};
+        };
+
+        Header header;
+        if (data.size() < sizeof(Header))
+        {
+            return reject();
+        }
+        std::memcpy(&header, data.data(), sizeof(Header));
+
+        if (header.magic != cache_magic || header.version != cache_version
+            || header.flags != static_cast<std::uint32_t>(flags)
+            || header.vertex_stride != sizeof(Vertex)
+            || header.mesh_stride != sizeof(Mesh))
+        {
+            return reject();
+        }
+
+        auto source_mtime  = get_mtime(source);
+        bool mtime_changed = header.source_mtime != source_mtime;
+        if (header.source_size != fs::file_size(source, ec)
+            || (mtime_changed && header.source_hash != hash_file(source)))
+        {
+            return reject();
+        }
+
+        // Make sure all the sections actually fit before handing out views into them.
+        auto fits = [&data](std::uint64_t offset, std::uint64_t count, std::size_t size) {
+            return offset % section_alignment == 0 && offset <= data.size()
+                   && count <= (data.size() - offset) / size;
+        };
+
+        if (!fits(header.vertex_offset, header.vertex_count, sizeof(Vertex))
+            || !fits(header.index_offset, header.index_count, sizeof(std::uint32_t))
+            || !fits(header.mesh_offset, header.mesh_count, sizeof(Mesh)))
+        {
+            return reject();
+        }
+
+        auto materials = read_materials(data, header);
+        if (!materials)
+        {
+            return reject();
+        }
+
+        // The contents still match, so record the new mtime. Otherwise every load after
+        // a touch (e.g. the model copy on every build) would hash the source again.
+        if (mtime_changed)
+        {
+            write_source_mtime(cache_path, source_mtime);
+        }
+
+        auto base = data.data();
+        return CachedGeometry{
+            .meshes = {reinterpret_cast<Mesh const*>(base + header.mesh_offset),
+                       static_cast<std::size_t>(header.mesh_count)},
+            .vertices = {reinterpret_cast<Vertex const*>(base + header.vertex_offset),
+                         static_cast<std::size_t>(header.vertex_count)},
+            .indices = {reinterpret_cast<std::uint32_t const*>(base + header.index_offset),
+                        static_cast<std::size_t>(header.index_count)},
+            .materials = std::move(*materials)
+        };
+    }
+
+    void write(std::filesystem::path const& source,
+               CacheFlags flags,
+               CachedGeometry const& geometry)
+    {
+        namespace fs = std::filesystem;
+
+        Header header{.magic          = cache_magic,
+                      .version        = cache_version,
+                      .flags          = static_cast<std::uint32_t>(flags),
+                      .padding        = 0,
+                      .source_size    = fs::file_size(source),
+                      .source_mtime   = get_mtime(source),
+                      .source_hash    = hash_file(source),
+                      .vertex_stride  = sizeof(Vertex),
+                      .mesh_stride    = sizeof(Mesh),
+                      .vertex_count   = geometry.vertices.size(),
+                      .index_count    = geometry.indices.size(),
+                      .mesh_count     = geometry.meshes.size(),
+                      .material_count = geometry.materials.size()};
+
+        header.vertex_offset = align_up(sizeof(Header));
+        header.index_offset =
+            align_up(header.vertex_offset + geometry.vertices.size_bytes());
+        header.mesh_offset = align_up(header.index_offset + geometry.indices.size_bytes());
+        header.material_offset =
+            align_up(header.mesh_offset + geometry.meshes.size_bytes());
+
+        auto cache_path = get_cache_path(source);
+        auto tmp_path   = cache_path;
+        tmp_path += ".tmp";
+
+        {
+            std::ofstream stream{tmp_path, std::ios::binary | std::ios::trunc};
+            if (!stream.is_open())
+            {
+                fmt::print("warning: unable to write mesh cache {}\n", tmp_path.string());
+                return;
+            }
+
+            auto write_section = [&stream](std::uint64_t offset,
+                                           void const* bytes,
+                                           std::size_t size) {
+                // Pad up to the start of the section.
+                static constexpr char zeros[section_alignment]{};
+                auto pos = static_cast<std::uint64_t>(stream.tellp());
+                stream.write(zeros, static_cast<std::streamsize>(offset - pos));
+                stream.write(static_cast<char const*>(bytes),
+                             static_cast<std::streamsize>(size));
+            };
+
+            write_section(0, &header, sizeof(Header));
+            write_section(header.vertex_offset,
+                          geometry.vertices.data(),
+                          geometry.vertices.size_bytes());
+            write_section(header.index_offset,
+                          geometry.indices.data(),
+                          geometry.indices.size_bytes());
+            write_section(header.mesh_offset,
+                          geometry.meshes.data(),
+                          geometry.meshes.size_bytes());
+
+            // Only the start of the material table is aligned, the entries themselves
+            // are packed back to back.
+            write_section(header.material_offset, nullptr, 0);
+            for (auto const& material : geometry.materials)
+            {
+                auto const& path = material.diffuse_texture;
+                auto length      = static_cast<std::uint32_t>(path.size());
+                stream.write(reinterpret_cast<char const*>(&length), sizeof(length));
+                stream.write(path.data(), static_cast<std::streamsize>(path.size()));
+            }
+
+            if (!stream.good())
+            {
+                fmt::print("warning: unable to write mesh cache {}\n", tmp_path.string());
+                return;
+            }
+        }
+
+        std::error_code ec;
+        fs::rename(tmp_path, cache_path, ec);
+        if (ec)
+        {
+            fmt::print("warning: unable to replace mesh cache {}: {}\n",
+                       cache_path.string(),
+                       ec.message());
+            fs::remove(tmp_path, ec);
+        }
+    }
+} // namespace mesh_cache
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "vk_mesh.hpp"
+
+// Binary cache for models so warm loads can skip Assimp entirely. The cache lives next to
+// the source file and is laid out as:
+//
+// | header | vertex blob | index blob | mesh table | material table |
+//
+// Every section starts on a 16 byte boundary so the blobs can be used in place once the
+// file is mapped. The material table is the only part that gets copied out: each entry is
+// the length of the diffuse texture path as a u32, followed by the path itself.
+namespace mesh_cache
+{
+    // Describes how the cached geometry was produced. A cache is only used if these
+    // match what the caller is asking for.
+    enum class CacheFlags : std::uint32_t
+    {
+        eNone      = 0,
+        eOptimised = 1 << 0
+    };
+
+    struct CachedGeometry
+    {
+        std::span<Mesh const> meshes;
+        std::span<Vertex const> vertices;
+        std::span<std::uint32_t const> indices;
+        std::vector<MaterialInfo> materials;
+    };
+
+    std::filesystem::path get_cache_path(std::filesystem::path const& source);
+
+    // Maps the cache for source into file and returns views into it. Returns nothing if
+    // there is no cache or it is stale, in which case the source has to be re-imported.
+    std::optional<CachedGeometry> read(std::filesystem::path const& source,
+                                       CacheFlags flags,
+                                       MappedFile& file);
+
+    void write(std::filesystem::path const& source,
+               CacheFlags flags,
+               CachedGeometry const& geometry);
+} // namespace mesh_cache
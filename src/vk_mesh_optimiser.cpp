@@ -0,0 +1,97 @@
+#include "vk_mesh_optimiser.hpp"
+
+#include <meshoptimizer.h>
+
+namespace mesh_optimiser
+{
+    // Roughly what a typical desktop GPU behaves like. These only affect the reported
+    // statistics, not the optimisation itself.
+    static constexpr unsigned int cache_size{16};
+
+    // Allow the overdraw pass to make the vertex cache up to 5% worse.
+    static constexpr float overdraw_threshold{1.05f};
+
+    Statistics analyse(std::span<std::uint32_t const> indices, std::size_t vertex_count)
+    {
+        auto cache = meshopt_analyzeVertexCache(indices.data(),
+                                                indices.size(),
+                                                vertex_count,
+                                                cache_size,
+                                                0,
+                                                0);
+        auto fetch = meshopt_analyzeVertexFetch(indices.data(),
+                                                indices.size(),
+                                                vertex_count,
+                                                sizeof(Vertex));
+
+        return Statistics{.acmr      = cache.acmr,
+                          .atvr      = cache.atvr,
+                          .overfetch = fetch.overfetch};
+    }
+
+    Result optimise(std::span<Vertex> vertices, std::span<std::uint32_t> indices)
+    {
+        Result result;
+        result.before = analyse(indices, vertices.size());
+
+        if (vertices.empty() || indices.empty())
+        {
+            result.vertex_count = static_cast<std::uint32_t>(vertices.size());
+            result.after        = result.before;
+            return result;
+        }
+
+        // Collapse vertices that are bit-for-bit identical.
+        std::vector<std::uint32_t> remap(vertices.size());
+        auto unique_count = meshopt_generateVertexRemap(remap.data(),
+                                                        indices.data(),
+                                                        indices.size(),
+                                                        vertices.data(),
+                                                        vertices.size(),
+                                                        sizeof(Vertex));
+
+        std::vector<Vertex> unique_vertices(unique_count);
+        meshopt_remapVertexBuffer(unique_vertices.data(),
+                                  vertices.data(),
+                                  vertices.size(),
+                                  sizeof(Vertex),
+                                  remap.data());
+        meshopt_remapIndexBuffer(indices.data(),
+                                 indices.data(),
+                                 indices.size(),
+                                 remap.data());
+
+        // The overdraw pass needs float positions, which the vertex may not store
+        // directly depending on its layout.
+        std::vector<glm::vec3> positions(unique_count);
+        std::transform(unique_vertices.begin(),
+                       unique_vertices.end(),
+                       positions.begin(),
+                       [](Vertex const& vertex) { return vertex.get_position(); });
+
+        // Both of these support working in place.
+        meshopt_optimizeVertexCache(indices.data(),
+                                    indices.data(),
+                                    indices.size(),
+                                    unique_count);
+        meshopt_optimizeOverdraw(indices.data(),
+                                 indices.data(),
+                                 indices.size(),
+                                 &positions[0].x,
+                                 unique_count,
+                                 sizeof(glm::vec3),
+                                 overdraw_threshold);
+
+        // Finally write the vertices back in the order the index buffer uses them.
+        auto vertex_count = meshopt_optimizeVertexFetch(vertices.data(),
+                                                        indices.data(),
+                                                        indices.size(),
+                                                        unique_vertices.data(),
+                                                        unique_count,
+                                                        sizeof(Vertex));
+
+        result.vertex_count = static_cast<std::uint32_t>(vertex_count);
+        result.after        = analyse(indices, vertex_count);
+        return result;
+    }
+} // namespace mesh_optimiser
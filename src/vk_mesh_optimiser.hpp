@@ -0,0 +1,33 @@
+#pragma once
+
+#include "vk_mesh.hpp"
+
+// CPU-only optimisation pass for a single mesh, built on top of meshoptimizer. Nothing in
+// here touches Vulkan, so it can be run (and checked) against any loaded geometry.
+namespace mesh_optimiser
+{
+    struct Statistics
+    {
+        // Average cache miss ratio: vertex shader invocations per triangle.
+        float acmr{0.0f};
+        // Average transformed vertex ratio: vertex shader invocations per vertex.
+        float atvr{0.0f};
+        // Bytes fetched from the vertex buffer relative to its size.
+        float overfetch{0.0f};
+    };
+
+    struct Result
+    {
+        std::uint32_t vertex_count{0};
+        Statistics before;
+        Statistics after;
+    };
+
+    Statistics analyse(std::span<std::uint32_t const> indices, std::size_t vertex_count);
+
+    // Runs the full pipeline in place: deduplicate vertices, reorder triangles for the
+    // post-transform cache and then for overdraw, and finally reorder vertices in the
+    // order they are first referenced. The index count never changes, but the vertex
+    // count can shrink; the returned count is how many of vertices are still in use.
+    Result optimise(std::span<Vertex> vertices, std::span<std::uint32_t> indices);
+} // namespace mesh_optimiser
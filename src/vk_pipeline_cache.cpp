@@ -0,0 +1,95 @@
+#include "vk_pipeline_cache.hpp"
+
+namespace vk_pipeline_cache
+{
+    static bool is_compatible(std::vector<char> const& data,
+                              vk::PhysicalDeviceProperties const& properties)
+    {
+        vk::PipelineCacheHeaderVersionOne header;
+        if (data.size() < sizeof(header))
+        {
+            return false;
+        }
+
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        return header.headerSize >= sizeof(header)
+               && header.headerVersion == vk::PipelineCacheHeaderVersion::eOne
+               && header.vendorID == properties.vendorID
+               && header.deviceID == properties.deviceID
+               && header.pipelineCacheUUID == properties.pipelineCacheUUID;
+    }
+
+    std::unique_ptr<vk::raii::PipelineCache>
+    load(vk::raii::Device const& device,
+         vk::PhysicalDeviceProperties const& properties,
+         std::filesystem::path const& path)
+    {
+        std::vector<char> data;
+
+        std::ifstream stream{path, std::ios::ate | std::ios::binary};
+        if (stream.is_open())
+        {
+            std::size_t file_size = stream.tellg();
+            data.resize(file_size);
+            stream.seekg(0);
+            stream.read(data.data(), file_size);
+            stream.close();
+
+            if (!is_compatible(data, properties))
+            {
+                fmt::print("warning: discarding incompatible pipeline cache {}\n",
+                           path.string());
+                data.clear();
+            }
+        }
+
+        vk::PipelineCacheCreateInfo cache_info{.initialDataSize = data.size(),
+                                               .pInitialData    = data.data()};
+
+        if (!data.empty())
+        {
+            fmt::print("loaded {} bytes of pipeline cache from {}\n",
+                       data.size(),
+                       path.string());
+        }
+
+        return std::make_unique<vk::raii::PipelineCache>(device, cache_info);
+    }
+
+    void save(vk::raii::PipelineCache const& cache, std::filesystem::path const& path)
+    {
+        auto data = cache.getData();
+
+        auto tmp_path = path;
+        tmp_path += ".tmp";
+
+        {
+            std::ofstream stream{tmp_path, std::ios::binary | std::ios::trunc};
+            if (!stream.is_open())
+            {
+                fmt::print("error: unable to write pipeline cache {}\n",
+                           tmp_path.string());
+                return;
+            }
+
+            stream.write(reinterpret_cast<char const*>(data.data()), data.size());
+            if (!stream.good())
+            {
+                fmt::print("error: unable to write pipeline cache {}\n",
+                           tmp_path.string());
+                return;
+            }
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec)
+        {
+            fmt::print("error: unable to replace pipeline cache {}: {}\n",
+                       path.string(),
+                       ec.message());
+            std::filesystem::remove(tmp_path, ec);
+        }
+    }
+} // namespace vk_pipeline_cache
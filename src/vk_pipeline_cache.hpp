@@ -0,0 +1,16 @@
+#pragma once
+
+namespace vk_pipeline_cache
+{
+    // Creates a pipeline cache seeded with the contents of path. If the file is missing,
+    // truncated, or was written by a different driver/device, it is ignored and the
+    // cache starts out empty.
+    std::unique_ptr<vk::raii::PipelineCache>
+    load(vk::raii::Device const& device,
+         vk::PhysicalDeviceProperties const& properties,
+         std::filesystem::path const& path);
+
+    // Writes the cache contents to path. The data goes to a temporary file first which
+    // is then renamed over the destination, so a crash never leaves a partial file.
+    void save(vk::raii::PipelineCache const& cache, std::filesystem::path const& path);
+} // namespace vk_pipeline_cache
@@ -0,0 +1,330 @@
+#include "vk_profiler.hpp"
+#include "vk_types.hpp"
+
+Profiler::CpuScope::CpuScope(Profiler& profiler, char const* name) :
+    m_profiler{&profiler},
+    m_name{name},
+    m_start{profiler.now()}
+{}
+
+Profiler::CpuScope::~CpuScope()
+{
+    end();
+}
+
+void Profiler::CpuScope::end()
+{
+    if (m_profiler == nullptr)
+    {
+        return;
+    }
+
+    m_profiler->record(Event{.name     = m_name,
+                             .start_ns = m_start,
+                             .end_ns   = m_profiler->now(),
+                             .frame    = m_profiler->m_frame_number,
+                             .thread   = get_thread_id()});
+    m_profiler = nullptr;
+}
+
+Profiler::GpuScope::GpuScope(Profiler& profiler,
+                             vk::raii::CommandBuffer const& cmd,
+                             char const* name) :
+    m_profiler{&profiler},
+    m_cmd{&cmd}
+{
+    auto slot = profiler.m_current_slot;
+    if (!profiler.m_query_pool || slot == nullptr || slot->scope_count == max_gpu_scopes)
+    {
+        return;
+    }
+
+    m_query               = slot->scope_count++;
+    slot->names[*m_query] = name;
+
+    std::uint32_t first_query = profiler.m_current_slot_index * max_gpu_scopes * 2;
+    cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe,
+                       to_vk_type(profiler.m_query_pool),
+                       first_query + *m_query * 2);
+}
+
+Profiler::GpuScope::~GpuScope()
+{
+    if (!m_query)
+    {
+        return;
+    }
+
+    std::uint32_t first_query = m_profiler->m_current_slot_index * max_gpu_scopes * 2;
+    m_cmd->writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe,
+                          to_vk_type(m_profiler->m_query_pool),
+                          first_query + *m_query * 2 + 1);
+}
+
+Profiler::Profiler() :
+    m_epoch{Clock::now()},
+    m_events(event_capacity),
+    m_frame_times(frame_capacity, 0.0)
+{}
+
+void Profiler::init(vk::raii::Device const& device,
+                    vk::PhysicalDevice physical_device,
+                    std::uint32_t queue_family_index,
+                    std::uint32_t frames_in_flight)
+{
+    m_slots.resize(frames_in_flight);
+
+    // Not every queue supports timestamps, in which case we only get the CPU side.
+    auto families   = physical_device.getQueueFamilyProperties();
+    auto valid_bits = families[queue_family_index].timestampValidBits;
+    if (valid_bits == 0)
+    {
+        fmt::print("warning: queue family {} doesn't support timestamps, GPU scopes "
+                   "are disabled\n",
+                   queue_family_index);
+        return;
+    }
+
+    m_timestamp_mask = valid_bits == 64 ? ~std::uint64_t{0}
+                                        : (std::uint64_t{1} << valid_bits) - 1;
+    m_timestamp_period =
+        static_cast<double>(physical_device.getProperties().limits.timestampPeriod);
+
+    vk::QueryPoolCreateInfo pool_info{.queryType = vk::QueryType::eTimestamp,
+                                      .queryCount =
+                                          frames_in_flight * max_gpu_scopes * 2};
+    m_query_pool = std::make_unique<vk::raii::QueryPool>(device, pool_info);
+}
+
+void Profiler::begin_frame(std::uint64_t frame)
+{
+    auto start_ns = now();
+    if (m_last_frame_ns != 0)
+    {
+        m_frame_times[m_frame_head % m_frame_times.size()] =
+            static_cast<double>(start_ns - m_last_frame_ns) / 1.0e6;
+        ++m_frame_head;
+    }
+
+    m_last_frame_ns = start_ns;
+    m_frame_number  = frame;
+}
+
+void Profiler::begin_gpu_frame(std::uint32_t slot_index,
+                               vk::raii::CommandBuffer const& cmd)
+{
+    auto& slot = m_slots[slot_index];
+    resolve(slot, slot_index);
+
+    m_current_slot       = &slot;
+    m_current_slot_index = slot_index;
+    slot.frame           = m_frame_number;
+
+    if (m_query_pool)
+    {
+        cmd.resetQueryPool(to_vk_type(m_query_pool),
+                           slot_index * max_gpu_scopes * 2,
+                           max_gpu_scopes * 2);
+    }
+}
+
+void Profiler::mark_submit()
+{
+    if (m_current_slot != nullptr)
+    {
+        m_current_slot->submit_ns = now();
+        m_current_slot            = nullptr;
+    }
+}
+
+void Profiler::resolve_all()
+{
+    for (std::uint32_t i{0}; i < m_slots.size(); ++i)
+    {
+        resolve(m_slots[i], i);
+    }
+}
+
+Profiler::CpuScope Profiler::cpu_scope(char const* name)
+{
+    return CpuScope{*this, name};
+}
+
+Profiler::GpuScope Profiler::gpu_scope(vk::raii::CommandBuffer const& cmd,
+                                       char const* name)
+{
+    return GpuScope{*this, cmd, name};
+}
+
+void Profiler::write_chrome_trace(std::filesystem::path const& path) const
+{
+    std::ofstream stream{path};
+    if (!stream)
+    {
+        fmt::print("error: unable to write trace to {}\n", path.string());
+        return;
+    }
+
+    auto events = get_events();
+
+    // Complete ("X") events with timestamps in microseconds. The GPU gets its own track.
+    stream << "{\"traceEvents\":[\n";
+    stream << fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},"
+                          "\"args\":{{\"name\":\"GPU\"}}}}",
+                          static_cast<std::uint32_t>(Track::eGpu));
+    for (auto const& event : events)
+    {
+        stream << fmt::format(",\n{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\","
+                              "\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":0,\"tid\":{},"
+                              "\"args\":{{\"frame\":{}}}}}",
+                              event.name,
+                              event.thread == 0 ? "gpu" : "cpu",
+                              event.start_ns / 1.0e3,
+                              (event.end_ns - event.start_ns) / 1.0e3,
+                              event.thread,
+                              event.frame);
+    }
+    stream << "\n]}\n";
+
+    fmt::print("wrote {} trace events to {}\n", events.size(), path.string());
+}
+
+void Profiler::print_summary() const
+{
+    auto percentile = [](std::vector<double> const& sorted, double p) {
+        auto index = static_cast<std::size_t>(p * static_cast<double>(sorted.size()));
+        return sorted[std::min(index, sorted.size() - 1)];
+    };
+
+    auto print_row = [&percentile](std::string_view name, std::vector<double>& times) {
+        if (times.empty())
+        {
+            return;
+        }
+
+        std::sort(times.begin(), times.end());
+        fmt::print("    {:<16}{:>8}{:>10.3f}{:>10.3f}{:>10.3f} ms\n",
+                   name,
+                   times.size(),
+                   percentile(times, 0.50),
+                   percentile(times, 0.95),
+                   percentile(times, 0.99));
+    };
+
+    fmt::print("profile summary:\n");
+    fmt::print("    {:<16}{:>8}{:>10}{:>10}{:>10}\n",
+               "scope",
+               "count",
+               "p50",
+               "p95",
+               "p99");
+
+    std::vector<double> frame_times{
+        m_frame_times.begin(),
+        m_frame_times.begin()
+            + static_cast<std::ptrdiff_t>(std::min(m_frame_head, m_frame_times.size()))};
+    print_row("frame", frame_times);
+
+    // Group the scopes by name, keeping the CPU and GPU ones apart. There are only ever
+    // a handful of distinct names, so a linear search is fine.
+    std::vector<std::pair<std::string, std::vector<double>>> scopes;
+    for (auto const& event : get_events())
+    {
+        auto name = fmt::format("{}{}", event.thread == 0 ? "gpu:" : "", event.name);
+        auto it   = std::find_if(scopes.begin(), scopes.end(), [&name](auto const& s) {
+            return s.first == name;
+        });
+        if (it == scopes.end())
+        {
+            scopes.emplace_back(name, std::vector<double>{});
+            it = std::prev(scopes.end());
+        }
+
+        it->second.push_back(static_cast<double>(event.end_ns - event.start_ns) / 1.0e6);
+    }
+
+    for (auto& [name, times] : scopes)
+    {
+        print_row(name, times);
+    }
+}
+
+std::uint64_t Profiler::now() const
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_epoch)
+            .count());
+}
+
+void Profiler::record(Event const& event)
+{
+    // Claiming a slot is the only shared state, so writers never block each other. Once
+    // the ring wraps the oldest events are simply overwritten.
+    auto index = m_event_head.fetch_add(1, std::memory_order_relaxed);
+    m_events[index % m_events.size()] = event;
+}
+
+void Profiler::resolve(FrameSlot& slot, std::uint32_t slot_index)
+{
+    if (!m_query_pool || slot.scope_count == 0)
+    {
+        return;
+    }
+
+    auto [result, timestamps] =
+        m_query_pool->getResults<std::uint64_t>(slot_index * max_gpu_scopes * 2,
+                                                slot.scope_count * 2,
+                                                slot.scope_count * 2
+                                                    * sizeof(std::uint64_t),
+                                                sizeof(std::uint64_t),
+                                                vk::QueryResultFlagBits::e64);
+    std::uint32_t scope_count = slot.scope_count;
+    slot.scope_count          = 0;
+    if (result != vk::Result::eSuccess)
+    {
+        return;
+    }
+
+    // GPU timestamps live in their own time domain, so line the first one up with the
+    // point the frame was submitted at. That's not exact, but it keeps the relative
+    // timings within the frame intact, which is what matters.
+    auto to_ns = [this, base = timestamps[0] & m_timestamp_mask](std::uint64_t ticks) {
+        return static_cast<std::uint64_t>(
+            static_cast<double>((ticks & m_timestamp_mask) - base) * m_timestamp_period);
+    };
+
+    for (std::uint32_t i{0}; i < scope_count; ++i)
+    {
+        record(Event{.name     = slot.names[i],
+                     .start_ns = slot.submit_ns + to_ns(timestamps[i * 2]),
+                     .end_ns   = slot.submit_ns + to_ns(timestamps[i * 2 + 1]),
+                     .frame    = slot.frame,
+                     .thread   = static_cast<std::uint32_t>(Track::eGpu)});
+    }
+}
+
+std::vector<Profiler::Event> Profiler::get_events() const
+{
+    auto head  = m_event_head.load(std::memory_order_acquire);
+    auto count = std::min<std::uint64_t>(head, m_events.size());
+
+    std::vector<Event> events;
+    events.reserve(count);
+    for (auto i = head - count; i < head; ++i)
+    {
+        events.push_back(m_events[i % m_events.size()]);
+    }
+
+    std::sort(events.begin(), events.end(), [](Event const& a, Event const& b) {
+        return a.start_ns < b.start_ns;
+    });
+    return events;
+}
+
+std::uint32_t Profiler::get_thread_id()
+{
+    // Track 0 is reserved for the GPU.
+    static std::atomic<std::uint32_t> next_id{1};
+    thread_local std::uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+// Lightweight CPU and GPU profiler. CPU scopes can be opened from any thread and are
+// written into a fixed-size ring without taking any locks. GPU scopes are bracketed with
+// timestamp queries, one block of queries per frame in flight, and are read back when
+// that frame slot comes around again (i.e. after its last frame has been waited on). The
+// collected events can be written out as a Chrome trace (chrome://tracing or Perfetto) or
+// summarised as percentiles.
+class Profiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr std::size_t event_capacity{1 << 16};
+    static constexpr std::size_t frame_capacity{1 << 12};
+    static constexpr std::uint32_t max_gpu_scopes{8};
+
+    // Closes the scope when it goes out of scope, or earlier if end is called.
+    class CpuScope
+    {
+    public:
+        CpuScope(Profiler& profiler, char const* name);
+        ~CpuScope();
+
+        CpuScope(CpuScope const&)            = delete;
+        CpuScope& operator=(CpuScope const&) = delete;
+
+        void end();
+
+    private:
+        Profiler* m_profiler;
+        char const* m_name;
+        std::uint64_t m_start;
+    };
+
+    // Writes a timestamp at the top of the pipe on construction and one at the bottom on
+    // destruction, so it has to be closed before the command buffer is ended.
+    class GpuScope
+    {
+    public:
+        GpuScope(Profiler& profiler,
+                 vk::raii::CommandBuffer const& cmd,
+                 char const* name);
+        ~GpuScope();
+
+        GpuScope(GpuScope const&)            = delete;
+        GpuScope& operator=(GpuScope const&) = delete;
+
+    private:
+        Profiler* m_profiler;
+        vk::raii::CommandBuffer const* m_cmd;
+        std::optional<std::uint32_t> m_query;
+    };
+
+    Profiler();
+
+    void init(vk::raii::Device const& device,
+              vk::PhysicalDevice physical_device,
+              std::uint32_t queue_family_index,
+              std::uint32_t frames_in_flight);
+
+    // Starts a new frame. Frame times are measured between consecutive calls, and any
+    // scopes recorded from here on are tagged with frame.
+    void begin_frame(std::uint64_t frame);
+
+    // Resolves the GPU scopes that were last recorded for this slot and resets its
+    // queries. Has to be called after the slot's last frame has been waited on, and
+    // before any GPU scopes are opened in cmd.
+    void begin_gpu_frame(std::uint32_t slot, vk::raii::CommandBuffer const& cmd);
+
+    // Marks the point where the frame was submitted, which is what the GPU scopes of
+    // the frame are lined up against in the trace.
+    void mark_submit();
+
+    // Reads back every slot that still has results pending. Only call this once the
+    // device is idle.
+    void resolve_all();
+
+    CpuScope cpu_scope(char const* name);
+    GpuScope gpu_scope(vk::raii::CommandBuffer const& cmd, char const* name);
+
+    // Neither of these synchronise with threads that are still recording scopes.
+    void write_chrome_trace(std::filesystem::path const& path) const;
+    void print_summary() const;
+
+private:
+    enum class Track : std::uint32_t
+    {
+        eGpu = 0
+    };
+
+    struct Event
+    {
+        char const* name{nullptr};
+        std::uint64_t start_ns{0};
+        std::uint64_t end_ns{0};
+        std::uint64_t frame{0};
+        std::uint32_t thread{0};
+    };
+
+    struct FrameSlot
+    {
+        std::array<char const*, max_gpu_scopes> names{};
+        std::uint32_t scope_count{0};
+        std::uint64_t frame{0};
+        std::uint64_t submit_ns{0};
+    };
+
+    std::uint64_t now() const;
+    void record(Event const& event);
+    void resolve(FrameSlot& slot, std::uint32_t slot_index);
+    std::vector<Event> get_events() const;
+
+    static std::uint32_t get_thread_id();
+
+    Clock::time_point m_epoch;
+
+    std::vector<Event> m_events;
+    std::atomic<std::uint64_t> m_event_head{0};
+
+    // Only touched from the thread that drives the frames.
+    std::vector<double> m_frame_times;
+    std::size_t m_frame_head{0};
+    std::uint64_t m_frame_number{0};
+    std::uint64_t m_last_frame_ns{0};
+
+    std::unique_ptr<vk::raii::QueryPool> m_query_pool;
+    std::vector<FrameSlot> m_slots;
+    FrameSlot* m_current_slot{nullptr};
+    std::uint32_t m_current_slot_index{0};
+    double m_timestamp_period{1.0};
+    std::uint64_t m_timestamp_mask{0};
+};
@@ -0,0 +1,206 @@
+#include "vk_scene.hpp"
+
+#include <zeus/assert.hpp>
+
+void Scene::clear()
+{
+    m_positions.clear();
+    m_rotations.clear();
+    m_scales.clear();
+    m_parents.clear();
+    m_world_transforms.clear();
+    m_dirty.clear();
+    m_meshes.clear();
+    m_pipelines.clear();
+    m_materials.clear();
+    m_sort_keys.clear();
+    m_draw_order.clear();
+
+    m_any_dirty   = false;
+    m_order_dirty = false;
+}
+
+void Scene::reserve(std::size_t count)
+{
+    m_positions.reserve(count);
+    m_rotations.reserve(count);
+    m_scales.reserve(count);
+    m_parents.reserve(count);
+    m_world_transforms.reserve(count);
+    m_dirty.reserve(count);
+    m_meshes.reserve(count);
+    m_pipelines.reserve(count);
+    m_materials.reserve(count);
+}
+
+std::uint32_t Scene::add_object(ObjectInfo const& info)
+{
+    auto object = static_cast<std::uint32_t>(m_positions.size());
+    ASSERT(info.parent == no_parent || info.parent < object);
+    ASSERT(info.mesh == no_mesh || info.mesh <= max_sort_value);
+    ASSERT(info.pipeline <= max_pipeline);
+    ASSERT(info.material <= max_sort_value);
+
+    m_positions.push_back(info.position);
+    m_rotations.push_back(info.rotation);
+    m_scales.push_back(info.scale);
+    m_parents.push_back(info.parent);
+    m_world_transforms.emplace_back(1.0f);
+    m_dirty.push_back(1);
+    m_meshes.push_back(info.mesh);
+    m_pipelines.push_back(info.pipeline);
+    m_materials.push_back(info.material);
+
+    m_any_dirty = true;
+    if (info.mesh != no_mesh)
+    {
+        m_order_dirty = true;
+    }
+
+    return object;
+}
+
+void Scene::set_position(std::uint32_t object, glm::vec3 position)
+{
+    m_positions[object] = position;
+    mark_dirty(object);
+}
+
+void Scene::set_rotation(std::uint32_t object, glm::quat rotation)
+{
+    m_rotations[object] = rotation;
+    mark_dirty(object);
+}
+
+void Scene::set_scale(std::uint32_t object, glm::vec3 scale)
+{
+    m_scales[object] = scale;
+    mark_dirty(object);
+}
+
+void Scene::set_pipeline(std::uint32_t object, std::uint32_t pipeline)
+{
+    ASSERT(pipeline <= max_pipeline);
+    if (m_pipelines[object] != pipeline)
+    {
+        m_pipelines[object] = pipeline;
+        m_order_dirty       = m_order_dirty || m_meshes[object] != no_mesh;
+    }
+}
+
+void Scene::set_material(std::uint32_t object, std::uint32_t material)
+{
+    ASSERT(material <= max_sort_value);
+    if (m_materials[object] != material)
+    {
+        m_materials[object] = material;
+        m_order_dirty       = m_order_dirty || m_meshes[object] != no_mesh;
+    }
+}
+
+std::size_t Scene::update()
+{
+    if (!m_any_dirty)
+    {
+        return 0;
+    }
+
+    std::size_t rebuilt{0};
+    for (std::size_t i{0}; i < m_positions.size(); ++i)
+    {
+        // Parents always come first, so their flag is already final by now.
+        auto parent = m_parents[i];
+        if (parent != no_parent && m_dirty[parent])
+        {
+            m_dirty[i] = 1;
+        }
+
+        if (!m_dirty[i])
+        {
+            continue;
+        }
+
+        glm::mat4 local = glm::translate(glm::mat4{1.0f}, m_positions[i])
+                          * glm::mat4_cast(m_rotations[i])
+                          * glm::scale(glm::mat4{1.0f}, m_scales[i]);
+        m_world_transforms[i] =
+            parent == no_parent ? local : m_world_transforms[parent] * local;
+        ++rebuilt;
+    }
+
+    // Children read their parent's flag, so none can be cleared until the pass is done.
+    std::fill(m_dirty.begin(), m_dirty.end(), std::uint8_t{0});
+    m_any_dirty = false;
+
+    return rebuilt;
+}
+
+bool Scene::sort()
+{
+    if (!m_order_dirty)
+    {
+        return false;
+    }
+
+    // With the object index in the low bits every key is unique and the whole thing is a
+    // plain integer sort, which is a lot cheaper than sorting structs with a comparator.
+    m_sort_keys.clear();
+    for (std::size_t i{0}; i < m_meshes.size(); ++i)
+    {
+        if (m_meshes[i] == no_mesh)
+        {
+            continue;
+        }
+
+        m_sort_keys.push_back(std::uint64_t{m_pipelines[i]} << 56
+                              | std::uint64_t{m_materials[i]} << 44
+                              | std::uint64_t{m_meshes[i]} << 32 | i);
+    }
+
+    std::sort(m_sort_keys.begin(), m_sort_keys.end());
+
+    m_draw_order.resize(m_sort_keys.size());
+    for (std::size_t i{0}; i < m_sort_keys.size(); ++i)
+    {
+        m_draw_order[i] = static_cast<std::uint32_t>(m_sort_keys[i]);
+    }
+
+    m_order_dirty = false;
+    return true;
+}
+
+std::size_t Scene::size() const
+{
+    return m_positions.size();
+}
+
+std::uint32_t Scene::get_mesh(std::uint32_t object) const
+{
+    return m_meshes[object];
+}
+
+std::uint32_t Scene::get_pipeline(std::uint32_t object) const
+{
+    return m_pipelines[object];
+}
+
+std::uint32_t Scene::get_material(std::uint32_t object) const
+{
+    return m_materials[object];
+}
+
+glm::mat4 const& Scene::get_world_transform(std::uint32_t object) const
+{
+    return m_world_transforms[object];
+}
+
+std::span<std::uint32_t const> Scene::get_draw_order() const
+{
+    return m_draw_order;
+}
+
+void Scene::mark_dirty(std::uint32_t object)
+{
+    m_dirty[object] = 1;
+    m_any_dirty     = true;
+}
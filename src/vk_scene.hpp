@@ -0,0 +1,81 @@
+#pragma once
+
+// Flat scene graph. Every object has a local transform, an optional parent, and
+// optionally a mesh to draw. Transforms are stored as a structure of arrays and objects
+// are always stored after their parent, so bringing the world transforms up to date is a
+// single linear pass that only rebuilds what has changed.
+class Scene
+{
+public:
+    static constexpr std::uint32_t no_parent{std::numeric_limits<std::uint32_t>::max()};
+    static constexpr std::uint32_t no_mesh{std::numeric_limits<std::uint32_t>::max()};
+
+    // The sort key packs the pipeline, material and mesh above the object index, which
+    // leaves 8 bits for the pipeline and 12 for each of the others. These are only
+    // asserted here, so whatever builds the scene has to check its inputs up front.
+    static constexpr std::uint32_t max_pipeline{0xff};
+    static constexpr std::uint32_t max_sort_value{0xfff};
+
+    struct ObjectInfo
+    {
+        glm::vec3 position{0.0f};
+        glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+        glm::vec3 scale{1.0f};
+        std::uint32_t parent{no_parent};
+        std::uint32_t mesh{no_mesh};
+        std::uint32_t pipeline{0};
+        std::uint32_t material{0};
+    };
+
+    void clear();
+    void reserve(std::size_t count);
+
+    // The parent, if there is one, has to have been added already. Returns the index of
+    // the new object.
+    std::uint32_t add_object(ObjectInfo const& info);
+
+    void set_position(std::uint32_t object, glm::vec3 position);
+    void set_rotation(std::uint32_t object, glm::quat rotation);
+    void set_scale(std::uint32_t object, glm::vec3 scale);
+    void set_pipeline(std::uint32_t object, std::uint32_t pipeline);
+    void set_material(std::uint32_t object, std::uint32_t material);
+
+    // Rebuilds the world transform of every object that changed since the last update,
+    // along with everything below it. Returns how many transforms were rebuilt.
+    std::size_t update();
+
+    // Rebuilds the draw order if objects were added or changed pipeline or material
+    // since the last sort. Returns whether the order changed.
+    bool sort();
+
+    std::size_t size() const;
+    std::uint32_t get_mesh(std::uint32_t object) const;
+    std::uint32_t get_pipeline(std::uint32_t object) const;
+    std::uint32_t get_material(std::uint32_t object) const;
+    glm::mat4 const& get_world_transform(std::uint32_t object) const;
+
+    // Every object with a mesh, ordered by pipeline, then material, then mesh, so that
+    // consecutive draws share as much state as possible.
+    std::span<std::uint32_t const> get_draw_order() const;
+
+private:
+    void mark_dirty(std::uint32_t object);
+
+    std::vector<glm::vec3> m_positions;
+    std::vector<glm::quat> m_rotations;
+    std::vector<glm::vec3> m_scales;
+    std::vector<std::uint32_t> m_parents;
+    std::vector<glm::mat4> m_world_transforms;
+
+    // Bytes rather than std::vector<bool> so the update loop doesn't have to unpack bits.
+    std::vector<std::uint8_t> m_dirty;
+    bool m_any_dirty{false};
+
+    std::vector<std::uint32_t> m_meshes;
+    std::vector<std::uint32_t> m_pipelines;
+    std::vector<std::uint32_t> m_materials;
+
+    std::vector<std::uint64_t> m_sort_keys;
+    std::vector<std::uint32_t> m_draw_order;
+    bool m_order_dirty{false};
+};
@@ -0,0 +1,559 @@
+#include "vk_textures.hpp"
+#include "shaders/bindings.h"
+#include "vk_initialisers.hpp"
+
+#include <zeus/assert.hpp>
+
+#pragma warning(push)
+#pragma warning(disable : 4244)
+#include <stb_image.h>
+#pragma warning(pop)
+
+// Everything is decoded to RGBA8. The maps referenced by materials hold colours, so they
+// are sampled as sRGB.
+static constexpr vk::Format texture_format{vk::Format::eR8G8B8A8Srgb};
+static constexpr vk::DeviceSize texel_size{4};
+
+static void transition_image(vk::raii::CommandBuffer const& cmd,
+                             vk::Image image,
+                             std::uint32_t base_level,
+                             std::uint32_t level_count,
+                             vk::ImageLayout old_layout,
+                             vk::ImageLayout new_layout,
+                             vk::PipelineStageFlags src_stage,
+                             vk::AccessFlags src_access,
+                             vk::PipelineStageFlags dst_stage,
+                             vk::AccessFlags dst_access)
+{
+    vk::ImageMemoryBarrier barrier{
+        .srcAccessMask       = src_access,
+        .dstAccessMask       = dst_access,
+        .oldLayout           = old_layout,
+        .newLayout           = new_layout,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = image,
+        .subresourceRange    = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                .baseMipLevel   = base_level,
+                                .levelCount     = level_count,
+                                .baseArrayLayer = 0,
+                                .layerCount     = 1}
+    };
+
+    cmd.pipelineBarrier(src_stage, dst_stage, {}, {}, {}, {barrier});
+}
+
+void SamplerCache::init(vk::raii::Device const& device)
+{
+    m_device = &device;
+}
+
+void SamplerCache::destroy()
+{
+    m_samplers.clear();
+}
+
+vk::Sampler SamplerCache::get(SamplerDesc const& desc)
+{
+    ASSERT(m_device != nullptr);
+
+    auto it = m_samplers.find(desc);
+    if (it == m_samplers.end())
+    {
+        vk::SamplerCreateInfo info{.magFilter    = desc.mag_filter,
+                                   .minFilter    = desc.min_filter,
+                                   .mipmapMode   = desc.mipmap_mode,
+                                   .addressModeU = desc.address_mode,
+                                   .addressModeV = desc.address_mode,
+                                   .addressModeW = desc.address_mode,
+                                   .minLod       = 0.0f,
+                                   .maxLod       = VK_LOD_CLAMP_NONE};
+        it = m_samplers.emplace(desc, vk::raii::Sampler{*m_device, info}).first;
+    }
+
+    return *it->second;
+}
+
+void TextureCache::PixelDeleter::operator()(std::uint8_t* pixels) const
+{
+    stbi_image_free(pixels);
+}
+
+void TextureCache::init(vk::raii::Device const& device,
+                        vk::PhysicalDevice physical_device,
+                        VmaAllocator allocator,
+                        UploadContext& upload_context,
+                        DescriptorAllocator& descriptor_allocator,
+                        std::uint32_t frames_in_flight,
+                        std::uint32_t decode_threads)
+{
+    m_device         = &device;
+    m_allocator      = allocator;
+    m_upload_context = &upload_context;
+
+    // Mips are generated by blitting each level down from the one above it, which needs
+    // linear filtering on the format. Pretty much everything supports that for RGBA8,
+    // but if not the textures just get a single level.
+    using Feature = vk::FormatFeatureFlagBits;
+    vk::FormatFeatureFlags required =
+        Feature::eBlitSrc | Feature::eBlitDst | Feature::eSampledImageFilterLinear;
+    auto properties = physical_device.getFormatProperties(texture_format);
+    m_generate_mips = (properties.optimalTilingFeatures & required) == required;
+    if (!m_generate_mips)
+    {
+        fmt::print("warning: {} can't be blitted, textures won't have mipmaps\n",
+                   vk::to_string(texture_format));
+    }
+
+    m_samplers.init(device);
+
+    // Slots past the last texture are never written, hence partially bound.
+    m_set_layout = std::make_unique<vk::raii::DescriptorSetLayout>(
+        DescriptorLayoutBuilder{}
+            .add_binding(TEXTURE_ARRAY_BINDING,
+                         vk::DescriptorType::eCombinedImageSampler,
+                         vk::ShaderStageFlagBits::eFragment,
+                         max_textures,
+                         vk::DescriptorBindingFlagBits::ePartiallyBound)
+            .build(device));
+
+    for (std::uint32_t i{0}; i < frames_in_flight; ++i)
+    {
+        m_sets.push_back(descriptor_allocator.allocate(to_vk_type(m_set_layout)));
+    }
+    m_descriptor_heads.assign(frames_in_flight, 0);
+
+    m_decode_pool = std::make_unique<ThreadPool>(decode_threads);
+
+    // The default texture is finished off like any other, and its batch comes before
+    // the scene's, which the engine waits on before the first frame. It's therefore
+    // always resident by the time anything is drawn.
+    Texture texture{.sampler = m_samplers.get({})};
+    create_image(texture, 1, 1);
+
+    std::uint32_t texel{0xffffffff};
+    auto const& cmd = m_upload_context->get_command_buffer();
+    transition_image(cmd,
+                     texture.image.image,
+                     0,
+                     1,
+                     vk::ImageLayout::eUndefined,
+                     vk::ImageLayout::eTransferDstOptimal,
+                     vk::PipelineStageFlagBits::eTopOfPipe,
+                     {},
+                     vk::PipelineStageFlagBits::eTransfer,
+                     vk::AccessFlagBits::eTransferWrite);
+
+    vk::BufferImageCopy region{
+        .imageSubresource = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                             .mipLevel       = 0,
+                             .baseArrayLayer = 0,
+                             .layerCount     = 1},
+        .imageOffset      = {0, 0, 0},
+        .imageExtent      = {1, 1, 1}
+    };
+    m_upload_context->upload(texture.image.image, region, &texel, sizeof(texel));
+    m_upload_context->release(texture.image.image,
+                              get_subresource_range(texture),
+                              vk::ImageLayout::eTransferDstOptimal);
+    texture.upload_value = m_upload_context->submit();
+
+    m_textures.push_back(std::move(texture));
+    m_descriptor_log.push_back(default_texture);
+    m_uploading.push_back(default_texture);
+}
+
+void TextureCache::destroy()
+{
+    // Anything still queued is skipped, but a decode that is already running has to be
+    // allowed to finish since it writes back into the cache.
+    m_cancel_decodes = true;
+    m_decode_pool.reset();
+
+    m_upload_context->wait(m_upload_context->submit());
+
+    m_streaming.clear();
+    m_decoded.clear();
+
+    for (auto& texture : m_textures)
+    {
+        texture.view.reset();
+        if (texture.image.image)
+        {
+            vmaDestroyImage(m_allocator, texture.image.image, texture.image.allocation);
+        }
+    }
+    m_textures.clear();
+
+    m_samplers.destroy();
+    m_set_layout.reset();
+}
+
+std::uint32_t TextureCache::request(std::filesystem::path const& path,
+                                    SamplerDesc const& sampler)
+{
+    if (auto it = m_slots.find(path); it != m_slots.end())
+    {
+        return it->second;
+    }
+
+    if (m_textures.size() == max_textures)
+    {
+        fmt::print("warning: out of texture slots, {} will use the default texture\n",
+                   path.string());
+        return default_texture;
+    }
+
+    auto slot = static_cast<std::uint32_t>(m_textures.size());
+    m_textures.push_back(Texture{.path      = path,
+                                 .sampler   = m_samplers.get(sampler),
+                                 .requested = Clock::now()});
+    m_slots.emplace(path, slot);
+
+    // Until the image arrives the slot has to point at something valid.
+    m_descriptor_log.push_back(slot);
+
+    m_decode_pool->submit([this, slot, path]() {
+        decode(slot, path);
+    });
+
+    return slot;
+}
+
+void TextureCache::update(std::uint32_t frame_slot,
+                          vk::raii::CommandBuffer const& cmd,
+                          std::pmr::memory_resource& arena)
+{
+    {
+        std::scoped_lock lock{m_decoded_mutex};
+        for (auto& image : m_decoded)
+        {
+            // Failed decodes have already been reported and just keep the default.
+            if (image.pixels)
+            {
+                m_streaming.push_back(StreamingImage{.image = std::move(image)});
+            }
+        }
+        m_decoded.clear();
+    }
+
+    // Work through the decoded images in order, so each one becomes resident as soon as
+    // possible instead of all of them finishing together at the end.
+    std::pmr::vector<std::uint32_t> finished{&arena};
+    vk::DeviceSize budget = upload_budget;
+    bool recorded{false};
+    while (!m_streaming.empty() && budget > 0)
+    {
+        auto& streaming = m_streaming.front();
+        budget -= std::min(budget, stream_rows(streaming, budget));
+        recorded = true;
+
+        if (streaming.next_row == streaming.image.height)
+        {
+            finished.push_back(streaming.image.slot);
+            m_streaming.pop_front();
+        }
+    }
+
+    if (recorded)
+    {
+        auto value = m_upload_context->submit();
+        for (auto slot : finished)
+        {
+            m_textures[slot].upload_value = value;
+            m_uploading.push_back(slot);
+        }
+    }
+
+    for (auto it = m_uploading.begin(); it != m_uploading.end();)
+    {
+        auto& texture = m_textures[*it];
+        if (!m_upload_context->is_acquired(texture.upload_value))
+        {
+            ++it;
+            continue;
+        }
+
+        // Recorded ahead of anything that samples from it, so the frame can already
+        // draw with it.
+        finish_upload(cmd, texture);
+        texture.resident = true;
+        m_descriptor_log.push_back(*it);
+        it = m_uploading.erase(it);
+
+        if (texture.path.empty())
+        {
+            continue;
+        }
+
+        auto elapsed =
+            std::chrono::duration<double, std::milli>(Clock::now() - texture.requested);
+        fmt::print("loaded texture {} ({}x{}, {} mips) in {:.3f} ms\n",
+                   texture.path.filename().string(),
+                   texture.extent.width,
+                   texture.extent.height,
+                   texture.mip_levels,
+                   elapsed.count());
+    }
+
+    write_descriptors(frame_slot, arena);
+}
+
+vk::DescriptorSetLayout TextureCache::get_set_layout() const
+{
+    return to_vk_type(m_set_layout);
+}
+
+vk::DescriptorSet TextureCache::get_set(std::uint32_t frame_slot) const
+{
+    return m_sets[frame_slot];
+}
+
+void TextureCache::decode(std::uint32_t slot, std::filesystem::path const& path)
+{
+    if (m_cancel_decodes)
+    {
+        return;
+    }
+
+    int width{0};
+    int height{0};
+    int channels{0};
+    Pixels pixels{stbi_load(path.string().c_str(), &width, &height, &channels, 4)};
+    if (!pixels)
+    {
+        fmt::print("warning: unable to load texture {}: {}\n",
+                   path.string(),
+                   stbi_failure_reason());
+    }
+
+    std::scoped_lock lock{m_decoded_mutex};
+    m_decoded.push_back(DecodedImage{.slot   = slot,
+                                     .width  = static_cast<std::uint32_t>(width),
+                                     .height = static_cast<std::uint32_t>(height),
+                                     .pixels = std::move(pixels)});
+}
+
+void TextureCache::create_image(Texture& texture,
+                                std::uint32_t width,
+                                std::uint32_t height)
+{
+    texture.extent     = vk::Extent2D{width, height};
+    texture.mip_levels = 1;
+    if (m_generate_mips)
+    {
+        // Halve until both sides are down to a single texel.
+        texture.mip_levels =
+            static_cast<std::uint32_t>(std::bit_width(std::max(width, height)));
+    }
+
+    // Transfer source as well, since every level but the last is blitted from.
+    auto image_info =
+        vk_initialisers::image_create_info(texture_format,
+                                           vk::ImageUsageFlagBits::eSampled
+                                               | vk::ImageUsageFlagBits::eTransferDst
+                                               | vk::ImageUsageFlagBits::eTransferSrc,
+                                           vk::Extent3D{width, height, 1});
+    image_info.mipLevels = texture.mip_levels;
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    if (vmaCreateImage(m_allocator,
+                       to_vkc_ptr(&image_info),
+                       &alloc_info,
+                       to_vkc_ptr(&texture.image.image),
+                       &texture.image.allocation,
+                       nullptr)
+        != VK_SUCCESS)
+    {
+        throw std::runtime_error{"error: unable to allocate texture"};
+    }
+
+    auto view_info =
+        vk_initialisers::image_view_create_info(texture_format,
+                                                texture.image.image,
+                                                vk::ImageAspectFlagBits::eColor);
+    view_info.subresourceRange.levelCount = texture.mip_levels;
+    texture.view = std::make_unique<vk::raii::ImageView>(*m_device, view_info);
+}
+
+vk::DeviceSize TextureCache::stream_rows(StreamingImage& streaming, vk::DeviceSize budget)
+{
+    auto& image   = streaming.image;
+    auto& texture = m_textures[image.slot];
+
+    auto const& cmd = m_upload_context->get_command_buffer();
+    if (streaming.next_row == 0)
+    {
+        create_image(texture, image.width, image.height);
+        transition_image(cmd,
+                         texture.image.image,
+                         0,
+                         texture.mip_levels,
+                         vk::ImageLayout::eUndefined,
+                         vk::ImageLayout::eTransferDstOptimal,
+                         vk::PipelineStageFlagBits::eTopOfPipe,
+                         {},
+                         vk::PipelineStageFlagBits::eTransfer,
+                         vk::AccessFlagBits::eTransferWrite);
+    }
+
+    // Always make some progress, even if a single row is over what's left of the budget.
+    vk::DeviceSize row_size = image.width * texel_size;
+    auto rows_left          = image.height - streaming.next_row;
+    auto rows               = static_cast<std::uint32_t>(
+        std::clamp<vk::DeviceSize>(budget / row_size, 1, rows_left));
+
+    vk::BufferImageCopy region{
+        .imageSubresource = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                             .mipLevel       = 0,
+                             .baseArrayLayer = 0,
+                             .layerCount     = 1},
+        .imageOffset      = {0, static_cast<std::int32_t>(streaming.next_row), 0},
+        .imageExtent      = {image.width, rows, 1}
+    };
+
+    auto size = rows * row_size;
+    m_upload_context->upload(texture.image.image,
+                             region,
+                             image.pixels.get() + streaming.next_row * row_size,
+                             size);
+
+    streaming.next_row += rows;
+    if (streaming.next_row == image.height)
+    {
+        m_upload_context->release(texture.image.image,
+                                  get_subresource_range(texture),
+                                  vk::ImageLayout::eTransferDstOptimal);
+    }
+
+    return size;
+}
+
+void TextureCache::finish_upload(vk::raii::CommandBuffer const& cmd,
+                                 Texture const& texture)
+{
+    auto image = texture.image.image;
+
+    // Each level is filled from the one above it, which has to be moved over to being a
+    // transfer source first.
+    auto width  = static_cast<std::int32_t>(texture.extent.width);
+    auto height = static_cast<std::int32_t>(texture.extent.height);
+    for (std::uint32_t level{1}; level < texture.mip_levels; ++level)
+    {
+        transition_image(cmd,
+                         image,
+                         level - 1,
+                         1,
+                         vk::ImageLayout::eTransferDstOptimal,
+                         vk::ImageLayout::eTransferSrcOptimal,
+                         vk::PipelineStageFlagBits::eTransfer,
+                         vk::AccessFlagBits::eTransferWrite,
+                         vk::PipelineStageFlagBits::eTransfer,
+                         vk::AccessFlagBits::eTransferRead);
+
+        auto next_width  = std::max(width / 2, 1);
+        auto next_height = std::max(height / 2, 1);
+
+        vk::ImageBlit blit{
+            .srcSubresource = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                               .mipLevel       = level - 1,
+                               .baseArrayLayer = 0,
+                               .layerCount     = 1},
+            .srcOffsets     = std::array{vk::Offset3D{0, 0, 0},
+                                     vk::Offset3D{width, height, 1}},
+            .dstSubresource = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                               .mipLevel       = level,
+                               .baseArrayLayer = 0,
+                               .layerCount     = 1},
+            .dstOffsets     = std::array{vk::Offset3D{0, 0, 0},
+                                     vk::Offset3D{next_width, next_height, 1}}
+        };
+        cmd.blitImage(image,
+                      vk::ImageLayout::eTransferSrcOptimal,
+                      image,
+                      vk::ImageLayout::eTransferDstOptimal,
+                      {blit},
+                      vk::Filter::eLinear);
+
+        width  = next_width;
+        height = next_height;
+    }
+
+    // Every level but the last one was a blit source, the last was only ever written.
+    auto last_level = texture.mip_levels - 1;
+    if (last_level > 0)
+    {
+        transition_image(cmd,
+                         image,
+                         0,
+                         last_level,
+                         vk::ImageLayout::eTransferSrcOptimal,
+                         vk::ImageLayout::eShaderReadOnlyOptimal,
+                         vk::PipelineStageFlagBits::eTransfer,
+                         vk::AccessFlagBits::eTransferRead,
+                         vk::PipelineStageFlagBits::eFragmentShader,
+                         vk::AccessFlagBits::eShaderRead);
+    }
+
+    transition_image(cmd,
+                     image,
+                     last_level,
+                     1,
+                     vk::ImageLayout::eTransferDstOptimal,
+                     vk::ImageLayout::eShaderReadOnlyOptimal,
+                     vk::PipelineStageFlagBits::eTransfer,
+                     vk::AccessFlagBits::eTransferWrite,
+                     vk::PipelineStageFlagBits::eFragmentShader,
+                     vk::AccessFlagBits::eShaderRead);
+}
+
+vk::ImageSubresourceRange TextureCache::get_subresource_range(Texture const& texture)
+{
+    return vk::ImageSubresourceRange{.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                                     .baseMipLevel   = 0,
+                                     .levelCount     = texture.mip_levels,
+                                     .baseArrayLayer = 0,
+                                     .layerCount     = 1};
+}
+
+void TextureCache::write_descriptors(std::uint32_t frame_slot,
+                                     std::pmr::memory_resource& arena)
+{
+    auto& head = m_descriptor_heads[frame_slot];
+    if (head == m_descriptor_log.size())
+    {
+        return;
+    }
+
+    // The image infos are pointed to by the writes, so they can't move around.
+    auto count = m_descriptor_log.size() - head;
+    std::pmr::vector<vk::DescriptorImageInfo> image_infos{&arena};
+    std::pmr::vector<vk::WriteDescriptorSet> writes{&arena};
+    image_infos.reserve(count);
+    writes.reserve(count);
+
+    auto const& fallback = m_textures[default_texture];
+    for (auto i = head; i < m_descriptor_log.size(); ++i)
+    {
+        auto slot             = m_descriptor_log[i];
+        auto const& texture   = m_textures[slot];
+        auto const& view_from = texture.resident ? texture : fallback;
+
+        image_infos.push_back(vk::DescriptorImageInfo{
+            .sampler     = texture.sampler,
+            .imageView   = to_vk_type(view_from.view),
+            .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal});
+        writes.push_back(vk::WriteDescriptorSet{
+            .dstSet          = m_sets[frame_slot],
+            .dstBinding      = TEXTURE_ARRAY_BINDING,
+            .dstArrayElement = slot,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eCombinedImageSampler,
+            .pImageInfo      = &image_infos.back()});
+    }
+
+    m_device->updateDescriptorSets(writes, {});
+    head = m_descriptor_log.size();
+}
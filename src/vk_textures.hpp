@@ -0,0 +1,164 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "vk_descriptors.hpp"
+#include "vk_types.hpp"
+#include "vk_upload.hpp"
+
+// Everything that goes into a sampler. Textures that ask for the same settings share the
+// same sampler, so this is also the key of the cache.
+struct SamplerDesc
+{
+    vk::Filter mag_filter{vk::Filter::eLinear};
+    vk::Filter min_filter{vk::Filter::eLinear};
+    vk::SamplerMipmapMode mipmap_mode{vk::SamplerMipmapMode::eLinear};
+    vk::SamplerAddressMode address_mode{vk::SamplerAddressMode::eRepeat};
+
+    auto operator<=>(SamplerDesc const&) const = default;
+};
+
+// Creates each distinct sampler once and hands out the same handle from then on. There
+// are only ever a handful of them, so they all live until the cache is destroyed.
+class SamplerCache
+{
+public:
+    void init(vk::raii::Device const& device);
+    void destroy();
+
+    vk::Sampler get(SamplerDesc const& desc);
+
+private:
+    vk::raii::Device const* m_device{nullptr};
+    std::map<SamplerDesc, vk::raii::Sampler> m_samplers;
+};
+
+// Streams textures in from disk without ever making the render thread wait on them:
+//
+// 1. request hands out a slot in the texture array straight away and queues the file to
+//    be decoded on a pool of its own, so slow decodes can't hold up the engine's workers.
+// 2. update copies decoded images into the staging ring a band of rows at a time, within
+//    a fixed budget per call, so large images trickle in over several frames. These run
+//    on the upload queue, which may not be able to do anything but copies.
+// 3. Once the upload has been acquired by the frame's queue, update generates the mips
+//    with blits in the frame's command buffer and switches the slot from the default
+//    texture over to the real one.
+//
+// Each frame in flight has its own copy of the descriptor set, which is only written
+// right after that frame has been waited on. A slot therefore never changes
+// under a frame the GPU may still be running, which is what lets the set do without
+// update-after-bind.
+class TextureCache
+{
+public:
+    static constexpr std::uint32_t max_textures{1024};
+
+    // Resident from the first frame on, and what every other slot points at until its
+    // own image is. It's a single white texel, so sampling it leaves the vertex colour as
+    // it is.
+    static constexpr std::uint32_t default_texture{0};
+
+    // Upper bound on the pixel data copied into the staging ring per update. It has to be
+    // well below the size of the ring so a frame's uploads never wait on the previous
+    // frame's.
+    static constexpr vk::DeviceSize upload_budget{16 * 1024 * 1024};
+
+    void init(vk::raii::Device const& device,
+              vk::PhysicalDevice physical_device,
+              VmaAllocator allocator,
+              UploadContext& upload_context,
+              DescriptorAllocator& descriptor_allocator,
+              std::uint32_t frames_in_flight,
+              std::uint32_t decode_threads);
+    void destroy();
+
+    // Returns the slot the texture will occupy. Asking for the same file again returns
+    // the same slot, with the sampler it was first requested with.
+    std::uint32_t request(std::filesystem::path const& path,
+                          SamplerDesc const& sampler = {});
+
+    // Has to be called from the render thread once per frame, after the last frame to
+    // use frame_slot has been waited on and the upload context's acquires have been
+    // recorded into cmd. Anything that samples from the set has to be recorded after
+    // this. Never waits on the decode threads or the GPU. Scratch data comes out of
+    // arena.
+    void update(std::uint32_t frame_slot,
+                vk::raii::CommandBuffer const& cmd,
+                std::pmr::memory_resource& arena);
+
+    vk::DescriptorSetLayout get_set_layout() const;
+    vk::DescriptorSet get_set(std::uint32_t frame_slot) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct PixelDeleter
+    {
+        void operator()(std::uint8_t* pixels) const;
+    };
+    using Pixels = std::unique_ptr<std::uint8_t, PixelDeleter>;
+
+    // Handed from the decode threads to the render thread. Pixels are always RGBA8, and
+    // are null if the file couldn't be decoded.
+    struct DecodedImage
+    {
+        std::uint32_t slot{0};
+        std::uint32_t width{0};
+        std::uint32_t height{0};
+        Pixels pixels;
+    };
+
+    // An image that is partway through being copied into the ring.
+    struct StreamingImage
+    {
+        DecodedImage image;
+        std::uint32_t next_row{0};
+    };
+
+    struct Texture
+    {
+        std::filesystem::path path;
+        vk::Sampler sampler;
+        vk_types::AllocatedImage image{};
+        std::unique_ptr<vk::raii::ImageView> view;
+        vk::Extent2D extent;
+        std::uint32_t mip_levels{1};
+        std::uint64_t upload_value{0};
+        bool resident{false};
+        Clock::time_point requested;
+    };
+
+    void decode(std::uint32_t slot, std::filesystem::path const& path);
+    void create_image(Texture& texture, std::uint32_t width, std::uint32_t height);
+    vk::DeviceSize stream_rows(StreamingImage& streaming, vk::DeviceSize budget);
+    void finish_upload(vk::raii::CommandBuffer const& cmd, Texture const& texture);
+    static vk::ImageSubresourceRange get_subresource_range(Texture const& texture);
+    void write_descriptors(std::uint32_t frame_slot, std::pmr::memory_resource& arena);
+
+    vk::raii::Device const* m_device{nullptr};
+    VmaAllocator m_allocator{nullptr};
+    UploadContext* m_upload_context{nullptr};
+    bool m_generate_mips{false};
+
+    SamplerCache m_samplers;
+    std::unique_ptr<vk::raii::DescriptorSetLayout> m_set_layout;
+    std::vector<vk::DescriptorSet> m_sets;
+
+    std::vector<Texture> m_textures;
+    std::map<std::filesystem::path, std::uint32_t> m_slots;
+
+    // Slots whose descriptor needs to be written, in the order they changed. Each frame
+    // keeps track of how far into this its set has caught up.
+    std::vector<std::uint32_t> m_descriptor_log;
+    std::vector<std::size_t> m_descriptor_heads;
+
+    // Only touched from the render thread.
+    std::deque<StreamingImage> m_streaming;
+    std::vector<std::uint32_t> m_uploading;
+
+    std::mutex m_decoded_mutex;
+    std::vector<DecodedImage> m_decoded;
+    std::atomic<bool> m_cancel_decodes{false};
+
+    // Declared last so the decode threads are joined before anything they use goes away.
+    std::unique_ptr<ThreadPool> m_decode_pool;
+};
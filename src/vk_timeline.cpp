@@ -0,0 +1,118 @@
+#include "vk_timeline.hpp"
+#include "vk_types.hpp"
+
+#include <zeus/assert.hpp>
+
+void QueueTimeline::init(vk::raii::Device const& device, vk::Queue queue)
+{
+    m_device = &device;
+    m_queue  = queue;
+
+    vk::SemaphoreTypeCreateInfo type_info{.semaphoreType = vk::SemaphoreType::eTimeline,
+                                          .initialValue  = 0};
+    vk::SemaphoreCreateInfo info{.pNext = &type_info};
+    m_semaphore = std::make_unique<vk::raii::Semaphore>(device, info);
+}
+
+void QueueTimeline::destroy()
+{
+    wait_idle();
+    m_semaphore.reset();
+}
+
+vk::Queue QueueTimeline::get_queue() const
+{
+    return m_queue;
+}
+
+vk::Semaphore QueueTimeline::get_semaphore() const
+{
+    return to_vk_type(m_semaphore);
+}
+
+std::uint64_t QueueTimeline::get_next_value() const
+{
+    return m_next_value;
+}
+
+std::uint64_t QueueTimeline::submit(vk::CommandBuffer cmd,
+                                    std::span<Wait const> waits,
+                                    vk::Semaphore binary_signal)
+{
+    ASSERT(waits.size() <= max_waits);
+
+    std::array<vk::Semaphore, max_waits> wait_semaphores;
+    std::array<std::uint64_t, max_waits> wait_values;
+    std::array<vk::PipelineStageFlags, max_waits> wait_stages;
+    for (std::size_t i{0}; i < waits.size(); ++i)
+    {
+        wait_semaphores[i] = waits[i].semaphore;
+        wait_values[i]     = waits[i].value;
+        wait_stages[i]     = waits[i].stage;
+    }
+
+    // The timeline always goes first, so the binary semaphore's value (which is ignored)
+    // can simply be left off the end when there isn't one.
+    auto value = m_next_value++;
+    std::array signal_semaphores{to_vk_type(m_semaphore), binary_signal};
+    std::array signal_values{value, std::uint64_t{0}};
+    std::uint32_t signal_count = binary_signal ? 2 : 1;
+    auto wait_count            = static_cast<std::uint32_t>(waits.size());
+
+    vk::TimelineSemaphoreSubmitInfo timeline_info{
+        .waitSemaphoreValueCount   = wait_count,
+        .pWaitSemaphoreValues      = wait_values.data(),
+        .signalSemaphoreValueCount = signal_count,
+        .pSignalSemaphoreValues    = signal_values.data()};
+    vk::SubmitInfo submit_info{.pNext                = &timeline_info,
+                               .waitSemaphoreCount   = wait_count,
+                               .pWaitSemaphores      = wait_semaphores.data(),
+                               .pWaitDstStageMask    = wait_stages.data(),
+                               .commandBufferCount   = 1,
+                               .pCommandBuffers      = &cmd,
+                               .signalSemaphoreCount = signal_count,
+                               .pSignalSemaphores    = signal_semaphores.data()};
+    m_queue.submit({submit_info});
+
+    return value;
+}
+
+void QueueTimeline::wait(std::uint64_t value)
+{
+    if (value <= m_completed_value)
+    {
+        return;
+    }
+
+    auto semaphore = to_vk_type(m_semaphore);
+    vk::SemaphoreWaitInfo wait_info{.semaphoreCount = 1,
+                                    .pSemaphores    = &semaphore,
+                                    .pValues        = &value};
+
+    [[maybe_unused]] auto result =
+        m_device->waitSemaphores(wait_info, std::numeric_limits<std::uint64_t>::max());
+
+    m_completed_value = value;
+}
+
+void QueueTimeline::wait_idle()
+{
+    wait(m_next_value - 1);
+}
+
+bool QueueTimeline::is_complete(std::uint64_t value)
+{
+    return value <= get_completed_value();
+}
+
+std::uint64_t QueueTimeline::get_completed_value()
+{
+    // Nothing can be outstanding if every value handed out has been seen already, so
+    // skip the query.
+    if (m_completed_value + 1 < m_next_value)
+    {
+        m_completed_value = std::max(m_completed_value, m_semaphore->getCounterValue());
+    }
+
+    return m_completed_value;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Every submission to a queue goes through here and signals the next value of the queue's
+// timeline semaphore. Queues execute submissions in order, so once a value has been
+// reached everything submitted before it is done as well. That makes a single number
+// enough to wait on a frame, to know when a retired resource is safe to free, or to
+// check on an upload.
+class QueueTimeline
+{
+public:
+    // Submissions wait on at most this many semaphores.
+    static constexpr std::size_t max_waits{4};
+
+    // Binary semaphores ignore the value.
+    struct Wait
+    {
+        vk::Semaphore semaphore;
+        std::uint64_t value{0};
+        vk::PipelineStageFlags stage;
+    };
+
+    void init(vk::raii::Device const& device, vk::Queue queue);
+    void destroy();
+
+    vk::Queue get_queue() const;
+    vk::Semaphore get_semaphore() const;
+
+    // The value the next submit will signal. Anything the queue is using right now is
+    // done once it has been reached, so this is what retired resources are stamped with.
+    std::uint64_t get_next_value() const;
+
+    // Submits cmd and returns the value it signals. The binary semaphore, if any, is
+    // signaled alongside the timeline (e.g. for presentation).
+    std::uint64_t submit(vk::CommandBuffer cmd,
+                         std::span<Wait const> waits = {},
+                         vk::Semaphore binary_signal = {});
+
+    // Blocks until the timeline reaches value. Cheap if it already has.
+    void wait(std::uint64_t value);
+
+    // Blocks until everything submitted so far is done.
+    void wait_idle();
+
+    // Same as wait, but never blocks.
+    bool is_complete(std::uint64_t value);
+
+    // Highest value the GPU has signaled.
+    std::uint64_t get_completed_value();
+
+private:
+    vk::raii::Device const* m_device{nullptr};
+    vk::Queue m_queue;
+    std::unique_ptr<vk::raii::Semaphore> m_semaphore;
+
+    std::uint64_t m_next_value{1};
+    std::uint64_t m_completed_value{0};
+};
@@ -0,0 +1,33 @@
+#include "vk_types.hpp"
+
+namespace vk_types
+{
+    AllocatedBuffer create_buffer(VmaAllocator allocator,
+                                  vk::DeviceSize size,
+                                  vk::BufferUsageFlags usage,
+                                  VmaMemoryUsage memory_usage,
+                                  VmaAllocationCreateFlags flags)
+    {
+        vk::BufferCreateInfo buffer_info{.size = size, .usage = usage};
+
+        VmaAllocationCreateInfo alloc_info = {};
+        alloc_info.usage                   = memory_usage;
+        alloc_info.flags                   = flags;
+
+        AllocatedBuffer buffer;
+        VmaAllocationInfo allocation_info;
+        if (vmaCreateBuffer(allocator,
+                            to_vkc_ptr(&buffer_info),
+                            &alloc_info,
+                            to_vkc_ptr(&buffer.buffer),
+                            &buffer.allocation,
+                            &allocation_info)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error{"error: unable to allocate buffer"};
+        }
+
+        buffer.mapped_data = allocation_info.pMappedData;
+        return buffer;
+    }
+} // namespace vk_types
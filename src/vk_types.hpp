@@ -1,11 +1,37 @@
 #pragma once
 
+// Convert from a pointer to a vk::raii object to the corresponding vk:: object.
+template<typename T>
+auto to_vk_type(T const& ptr)
+{
+    return *(*ptr);
+}
+
+// Convert a vk:: type pointer to a pointer of the corresponding vk type (C-version)
+template<typename T>
+auto to_vkc_ptr(T* ptr)
+{
+    return reinterpret_cast<T::NativeType*>(ptr);
+}
+
+// Convert a vk:: flag bit type into the corresponding vk flag type (C-Version)
+template<typename T>
+auto to_vkc_flag(T flag_bits)
+{
+    using FlagType   = vk::Flags<T>;
+    using VkFlagType = FlagType::MaskType;
+    return static_cast<VkFlagType>(FlagType{flag_bits});
+}
+
 namespace vk_types
 {
     struct AllocatedBuffer
     {
         vk::Buffer buffer;
         VmaAllocation allocation;
+
+        // Only set for buffers that were created persistently mapped.
+        void* mapped_data{nullptr};
     };
 
     struct AllocatedImage
@@ -13,4 +39,10 @@ namespace vk_types
         vk::Image image;
         VmaAllocation allocation;
     };
+
+    AllocatedBuffer create_buffer(VmaAllocator allocator,
+                                  vk::DeviceSize size,
+                                  vk::BufferUsageFlags usage,
+                                  VmaMemoryUsage memory_usage,
+                                  VmaAllocationCreateFlags flags = 0);
 } // namespace vk_types
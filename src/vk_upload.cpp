@@ -0,0 +1,340 @@
+#include "vk_upload.hpp"
+#include "vk_initialisers.hpp"
+
+#include <zeus/assert.hpp>
+
+// Keep every sub-allocation aligned so the same ring can later feed buffer-to-image
+// copies, which need offsets that are a multiple of the texel size.
+static constexpr vk::DeviceSize staging_alignment{16};
+
+static vk::DeviceSize align_up(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void UploadContext::init(vk::raii::Device const& device,
+                         VmaAllocator allocator,
+                         QueueTimeline& timeline,
+                         std::uint32_t queue_family_index,
+                         std::uint32_t destination_family_index,
+                         vk::DeviceSize staging_size)
+{
+    using namespace vk_initialisers;
+
+    m_device    = &device;
+    m_allocator = allocator;
+    m_timeline  = &timeline;
+
+    m_family_index             = queue_family_index;
+    m_destination_family_index = destination_family_index;
+
+    {
+        auto info = command_pool_create_info(queue_family_index,
+                                             vk::CommandPoolCreateFlagBits::eTransient);
+        m_pool    = std::make_unique<vk::raii::CommandPool>(device, info);
+    }
+
+    // CPU_ONLY memory is host coherent, so writes through the mapped pointer don't need
+    // to be flushed.
+    m_staging  = vk_types::create_buffer(allocator,
+                                        staging_size,
+                                        vk::BufferUsageFlagBits::eTransferSrc,
+                                        VMA_MEMORY_USAGE_CPU_ONLY,
+                                        VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    m_capacity = staging_size;
+}
+
+void UploadContext::destroy()
+{
+    wait(m_last_value);
+    m_in_flight.clear();
+    m_handovers.clear();
+
+    vmaDestroyBuffer(m_allocator, m_staging.buffer, m_staging.allocation);
+    m_staging = {};
+}
+
+void UploadContext::upload(vk::Buffer dst,
+                           vk::DeviceSize dst_offset,
+                           void const* data,
+                           vk::DeviceSize size)
+{
+    auto bytes = static_cast<std::byte const*>(data);
+    auto ring  = static_cast<std::byte*>(m_staging.mapped_data);
+
+    if (needs_ownership_transfer()
+        && std::find(m_unreleased.begin(), m_unreleased.end(), dst) == m_unreleased.end())
+    {
+        m_unreleased.push_back(dst);
+    }
+
+    // Anything bigger than the ring gets split into chunks that fit.
+    while (size > 0)
+    {
+        auto chunk  = std::min(size, m_capacity);
+        auto offset = allocate(chunk);
+        std::memcpy(ring + offset, bytes, chunk);
+
+        vk::BufferCopy region{.srcOffset = offset, .dstOffset = dst_offset, .size = chunk};
+        get_command_buffer().copyBuffer(m_staging.buffer, dst, {region});
+
+        bytes += chunk;
+        dst_offset += chunk;
+        size -= chunk;
+    }
+}
+
+void UploadContext::upload(vk::Image dst,
+                           vk::BufferImageCopy region,
+                           void const* data,
+                           vk::DeviceSize size)
+{
+    auto ring = static_cast<std::byte*>(m_staging.mapped_data);
+
+    auto offset = allocate(size);
+    std::memcpy(ring + offset, data, size);
+
+    region.bufferOffset = offset;
+    get_command_buffer().copyBufferToImage(m_staging.buffer,
+                                           dst,
+                                           vk::ImageLayout::eTransferDstOptimal,
+                                           {region});
+}
+
+void UploadContext::release(vk::Image image,
+                            vk::ImageSubresourceRange const& range,
+                            vk::ImageLayout layout)
+{
+    if (!needs_ownership_transfer())
+    {
+        return;
+    }
+
+    // The release and the acquire have to match exactly, apart from the access masks.
+    vk::ImageMemoryBarrier barrier{
+        .srcAccessMask       = vk::AccessFlagBits::eTransferWrite,
+        .oldLayout           = layout,
+        .newLayout           = layout,
+        .srcQueueFamilyIndex = m_family_index,
+        .dstQueueFamilyIndex = m_destination_family_index,
+        .image               = image,
+        .subresourceRange    = range};
+    get_command_buffer().pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                                         vk::PipelineStageFlagBits::eBottomOfPipe,
+                                         {},
+                                         {},
+                                         {},
+                                         {barrier});
+
+    barrier.srcAccessMask = {};
+    barrier.dstAccessMask =
+        vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+    m_pending_handover.images.push_back(barrier);
+}
+
+std::uint64_t UploadContext::submit()
+{
+    release_buffers();
+    return flush();
+}
+
+std::uint64_t UploadContext::flush()
+{
+    if (!m_recording)
+    {
+        // Nothing new, so the last value we handed out already covers everything.
+        return m_last_value;
+    }
+
+    auto const& cmd = m_pending.cmd;
+
+    // Make the copies visible to whatever ends up reading the buffers (vertex input,
+    // index reads, shaders, etc).
+    vk::MemoryBarrier barrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                              .dstAccessMask = vk::AccessFlagBits::eMemoryRead};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eAllCommands,
+                        {},
+                        {barrier},
+                        {},
+                        {});
+    cmd.end();
+
+    m_pending.value = m_timeline->submit(*cmd);
+    m_last_value    = m_pending.value;
+
+    if (!m_pending_handover.buffers.empty() || !m_pending_handover.images.empty())
+    {
+        m_pending_handover.value = m_pending.value;
+        m_handovers.push_back(std::move(m_pending_handover));
+        m_pending_handover = Handover{};
+    }
+
+    auto value = m_pending.value;
+    m_in_flight.push_back(std::move(m_pending));
+    m_pending   = Batch{};
+    m_recording = false;
+
+    return value;
+}
+
+void UploadContext::wait(std::uint64_t value)
+{
+    m_timeline->wait(value);
+    retire_completed();
+}
+
+std::uint64_t UploadContext::record_acquires(vk::raii::CommandBuffer const& cmd)
+{
+    // Anything that completes after this point waits for the next call, so a batch can
+    // never be reported as acquired before its barriers are in a command buffer.
+    auto completed = m_timeline->get_completed_value();
+    retire_completed();
+
+    std::uint64_t wait_value{0};
+    while (!m_handovers.empty() && m_handovers.front().value <= completed)
+    {
+        auto const& handover = m_handovers.front();
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe,
+                            vk::PipelineStageFlagBits::eAllCommands,
+                            {},
+                            {},
+                            handover.buffers,
+                            handover.images);
+
+        wait_value = handover.value;
+        m_handovers.pop_front();
+    }
+
+    m_acquired_value = completed;
+    return wait_value;
+}
+
+bool UploadContext::is_acquired(std::uint64_t value) const
+{
+    return value <= m_acquired_value;
+}
+
+bool UploadContext::needs_ownership_transfer() const
+{
+    return m_family_index != m_destination_family_index;
+}
+
+void UploadContext::release_buffers()
+{
+    if (m_unreleased.empty())
+    {
+        return;
+    }
+
+    // Released whole, since the acquire has to name exactly the same range.
+    auto const& cmd = get_command_buffer();
+    for (auto buffer : m_unreleased)
+    {
+        vk::BufferMemoryBarrier barrier{
+            .srcAccessMask       = vk::AccessFlagBits::eTransferWrite,
+            .srcQueueFamilyIndex = m_family_index,
+            .dstQueueFamilyIndex = m_destination_family_index,
+            .buffer              = buffer,
+            .offset              = 0,
+            .size                = VK_WHOLE_SIZE};
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                            vk::PipelineStageFlagBits::eBottomOfPipe,
+                            {},
+                            {},
+                            {barrier},
+                            {});
+
+        barrier.srcAccessMask = {};
+        barrier.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+        m_pending_handover.buffers.push_back(barrier);
+    }
+    m_unreleased.clear();
+}
+
+vk::DeviceSize UploadContext::allocate(vk::DeviceSize size)
+{
+    ASSERT(size <= m_capacity);
+
+    for (;;)
+    {
+        retire_completed();
+
+        Range range{.begin = align_up(m_head, staging_alignment)};
+        if (range.begin + size > m_capacity)
+        {
+            // Not enough room left at the end, so wrap around to the front.
+            range.begin = 0;
+        }
+        range.end = range.begin + size;
+
+        if (is_free(range))
+        {
+            m_pending.ranges.push_back(range);
+            m_head = range.end;
+            return range.begin;
+        }
+
+        if (m_in_flight.empty())
+        {
+            // The batch we're building is what's filling up the ring, so push it out
+            // and start over once it's done. Buffers can span several batches, so
+            // they're only released by the next real submit.
+            wait(flush());
+        }
+        else
+        {
+            wait(m_in_flight.front().value);
+        }
+    }
+}
+
+bool UploadContext::is_free(Range const& range) const
+{
+    auto overlaps = [&range](Range const& other) {
+        return range.begin < other.end && other.begin < range.end;
+    };
+
+    for (auto const& batch : m_in_flight)
+    {
+        if (std::any_of(batch.ranges.begin(), batch.ranges.end(), overlaps))
+        {
+            return false;
+        }
+    }
+
+    return std::none_of(m_pending.ranges.begin(), m_pending.ranges.end(), overlaps);
+}
+
+void UploadContext::retire_completed()
+{
+    if (m_in_flight.empty())
+    {
+        return;
+    }
+
+    auto completed = m_timeline->get_completed_value();
+    while (!m_in_flight.empty() && m_in_flight.front().value <= completed)
+    {
+        m_in_flight.pop_front();
+    }
+}
+
+vk::raii::CommandBuffer const& UploadContext::get_command_buffer()
+{
+    using namespace vk_initialisers;
+
+    if (!m_recording)
+    {
+        auto info = command_buffer_allocate_info(*m_pool);
+        vk::raii::CommandBuffers buffers{*m_device, info};
+        m_pending.cmd = std::move(buffers.front());
+
+        m_pending.cmd.begin(
+            vk::CommandBufferBeginInfo{.flags =
+                                           vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+        m_recording = true;
+    }
+
+    return m_pending.cmd;
+}
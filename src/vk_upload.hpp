@@ -0,0 +1,134 @@
+#pragma once
+
+#include "vk_timeline.hpp"
+#include "vk_types.hpp"
+
+// Moves data from the host into device-local memory. Everything goes through a single
+// persistently mapped staging buffer that is used as a ring: uploads sub-allocate from
+// it, get recorded into the pending batch and are sent to the GPU together when the batch
+// is submitted. Batches go through the queue's timeline like everything else, and the
+// value a batch signals is also how we know when its region of the ring can be reused.
+//
+// The queue can belong to a different family than the one that ends up using the data
+// (e.g. a dedicated transfer queue). In that case ownership of every destination is
+// released by the batch and has to be acquired on the destination family, through
+// record_acquires, before it can be used there.
+class UploadContext
+{
+public:
+    void init(vk::raii::Device const& device,
+              VmaAllocator allocator,
+              QueueTimeline& timeline,
+              std::uint32_t queue_family_index,
+              std::uint32_t destination_family_index,
+              vk::DeviceSize staging_size);
+    void destroy();
+
+    void upload(vk::Buffer dst,
+                vk::DeviceSize dst_offset,
+                void const* data,
+                vk::DeviceSize size);
+
+    template<typename T>
+    void upload(vk::Buffer dst, vk::DeviceSize dst_offset, std::span<T const> data)
+    {
+        upload(dst, dst_offset, data.data(), data.size_bytes());
+    }
+
+    // Copies data into the part of dst described by region, whose buffer offset is
+    // filled in here. The image has to be in TransferDstOptimal by the time the batch
+    // runs, and unlike buffer uploads this isn't split up, so size has to fit in the
+    // ring. Images are written over several batches, so unlike buffers they're only
+    // handed over once release is called.
+    void upload(vk::Image dst,
+                vk::BufferImageCopy region,
+                void const* data,
+                vk::DeviceSize size);
+
+    // Hands range of image over to the destination family once the pending batch has
+    // run. It stays in layout, and nothing else may be recorded for it on this queue.
+    void release(vk::Image image,
+                 vk::ImageSubresourceRange const& range,
+                 vk::ImageLayout layout);
+
+    // The command buffer of the batch being built, for anything that has to be recorded
+    // around the copies. It runs on the upload queue, so anything that needs graphics
+    // (blits, shader stages) has to wait until the data has been acquired.
+    vk::raii::CommandBuffer const& get_command_buffer();
+
+    // Submits every upload recorded since the last call, releasing the buffers they
+    // wrote to, and returns the timeline value that will be signaled once they have all
+    // landed.
+    std::uint64_t submit();
+
+    // Blocks until the timeline reaches value. Cheap if it already has.
+    void wait(std::uint64_t value);
+
+    // Records the acquiring half of every release whose batch has completed into cmd,
+    // which has to be submitted to the destination family. Returns the upload timeline
+    // value that submission has to wait on, or 0 if there's nothing to wait for. Never
+    // blocks.
+    std::uint64_t record_acquires(vk::raii::CommandBuffer const& cmd);
+
+    // Whether the batch that signals value has completed and anything it released has
+    // been acquired by record_acquires.
+    bool is_acquired(std::uint64_t value) const;
+
+    bool needs_ownership_transfer() const;
+
+private:
+    struct Range
+    {
+        vk::DeviceSize begin;
+        vk::DeviceSize end;
+    };
+
+    struct Batch
+    {
+        vk::raii::CommandBuffer cmd{nullptr};
+        std::vector<Range> ranges;
+        std::uint64_t value{0};
+    };
+
+    // The acquiring halves of the releases made by the batch that signals value.
+    struct Handover
+    {
+        std::uint64_t value{0};
+        std::vector<vk::BufferMemoryBarrier> buffers;
+        std::vector<vk::ImageMemoryBarrier> images;
+    };
+
+    // Ends and submits the pending batch without releasing anything, so the buffers
+    // can still be written to by the next one.
+    std::uint64_t flush();
+    void release_buffers();
+    vk::DeviceSize allocate(vk::DeviceSize size);
+    bool is_free(Range const& range) const;
+    void retire_completed();
+
+    vk::raii::Device const* m_device{nullptr};
+    VmaAllocator m_allocator{nullptr};
+    QueueTimeline* m_timeline{nullptr};
+    std::uint32_t m_family_index{0};
+    std::uint32_t m_destination_family_index{0};
+
+    std::unique_ptr<vk::raii::CommandPool> m_pool;
+
+    vk_types::AllocatedBuffer m_staging;
+    vk::DeviceSize m_capacity{0};
+    vk::DeviceSize m_head{0};
+
+    Batch m_pending;
+    bool m_recording{false};
+    std::deque<Batch> m_in_flight;
+
+    // Buffers written since the last submit, and the handovers waiting on their batch.
+    std::vector<vk::Buffer> m_unreleased;
+    Handover m_pending_handover;
+    std::deque<Handover> m_handovers;
+    std::uint64_t m_acquired_value{0};
+
+    // What the last batch signaled, so submitting with nothing recorded can still hand
+    // out a value that covers every upload so far.
+    std::uint64_t m_last_value{0};
+};
@@ -145,7 +145,7 @@ static void window_close_callback(GLFWwindow* window)
     }
 }
 
-VulkanApp::VulkanApp()
+void VulkanApp::create_window()
 {
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
@@ -162,11 +162,11 @@ VulkanApp::VulkanApp()
         std::abort();
     }
 
-    // Initialise the window to not be full-size or resizeable (mainly so we don't need to
-    // worry about details like rebuilding the swap chain).
+    // Initialise the window to not be full-size. Resizing is fine, since the engine
+    // rebuilds the swapchain whenever the framebuffer changes size.
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     glfwWindowHint(GLFW_MAXIMIZED, 0);
-    glfwWindowHint(GLFW_RESIZABLE, 0);
+    glfwWindowHint(GLFW_RESIZABLE, 1);
 
     m_window =
         glfwCreateWindow(window_width, window_height, "Vulkan App", nullptr, nullptr);
@@ -211,14 +211,55 @@ VulkanApp::VulkanApp()
     glfwSetFramebufferSizeCallback(m_window, framebuffer_size_callback);
     glfwSetWindowCloseCallback(m_window, window_close_callback);
     glfwSetCharCallback(m_window, char_callback);
+}
 
+VulkanApp::VulkanApp(AppOptions const& options) :
+    m_options{options}
+{
     m_engine = std::make_unique<VulkanEngine>();
-    m_engine->set_surface_callback([this](vk::Instance const& instance) {
-        VkSurfaceKHR surface;
-        glfwCreateWindowSurface(instance, m_window, nullptr, &surface);
-        return surface;
-    });
+    if (m_options.headless)
+    {
+        m_engine->set_headless(true);
+    }
+    else
+    {
+        create_window();
+        m_engine->set_surface_callback([this](vk::Instance const& instance) {
+            VkSurfaceKHR surface;
+            glfwCreateWindowSurface(instance, m_window, nullptr, &surface);
+            return surface;
+        });
+    }
+
     m_engine->set_window_extent({window_width, window_height});
+    m_engine->set_frames_in_flight(options.frames_in_flight);
+    if (options.indirect)
+    {
+        m_engine->set_render_mode(RenderMode::eIndirect);
+    }
+    else if (options.instanced)
+    {
+        m_engine->set_render_mode(RenderMode::eInstanced);
+    }
+    m_engine->set_object_count(options.object_count);
+    if (options.worker_count)
+    {
+        m_engine->set_worker_count(*options.worker_count);
+    }
+    m_engine->set_optimise_meshes(options.optimise_meshes);
+    if (options.model_path)
+    {
+        m_engine->set_model_path(*options.model_path);
+    }
+    m_engine->set_release_geometry(options.release_geometry);
+    m_engine->set_parallel_recording(options.parallel_recording);
+    m_engine->set_present_mode(options.present_mode);
+    m_engine->set_swapchain_image_count(options.swapchain_image_count);
+    m_engine->set_frame_pacing(options.frame_pacing);
+    if (options.trace_path)
+    {
+        m_engine->set_trace_path(*options.trace_path);
+    }
     m_engine->init();
 }
 
@@ -227,6 +268,11 @@ VulkanApp::~VulkanApp()
     // Make sure the engine is deleted BEFORE we destroy the GLFW state.
     m_engine = nullptr;
 
+    if (m_window == nullptr)
+    {
+        return;
+    }
+
     auto callbacks = static_cast<WindowCallbacks*>(glfwGetWindowUserPointer(m_window));
     delete callbacks;
     glfwSetWindowUserPointer(m_window, nullptr);
@@ -236,10 +282,45 @@ VulkanApp::~VulkanApp()
 
 void VulkanApp::run()
 {
-    while (!glfwWindowShouldClose(m_window))
+    std::uint32_t frame_count = m_options.frame_count;
+    if (m_options.headless)
     {
+        frame_count = std::max(frame_count, 1u);
+    }
+
+    for (std::uint32_t frame{0}; frame_count == 0 || frame < frame_count; ++frame)
+    {
+        // Sleep before polling so the input we render with is as fresh as possible.
+        m_engine->wait_for_next_frame();
+
+        if (m_window != nullptr)
+        {
+            if (glfwWindowShouldClose(m_window))
+            {
+                break;
+            }
+
+            // There's nothing to draw into while minimised, so sleep until that changes
+            // instead of spinning.
+            int width;
+            int height;
+            glfwGetFramebufferSize(m_window, &width, &height);
+            if (width == 0 || height == 0)
+            {
+                glfwWaitEvents();
+            }
+            else
+            {
+                glfwPollEvents();
+            }
+        }
+
+        if (m_options.capture_path && frame + 1 == frame_count)
+        {
+            m_engine->request_capture(*m_options.capture_path);
+        }
+
         m_engine->render();
-        glfwPollEvents();
     }
 }
 
@@ -267,9 +348,14 @@ void VulkanApp::on_key_press(int key,
 void VulkanApp::on_window_size([[maybe_unused]] int width, [[maybe_unused]] int height)
 {}
 
-void VulkanApp::on_framebuffer_size([[maybe_unused]] int width,
-                                    [[maybe_unused]] int height)
-{}
+void VulkanApp::on_framebuffer_size(int width, int height)
+{
+    if (m_engine)
+    {
+        m_engine->resize(
+            {static_cast<std::uint32_t>(width), static_cast<std::uint32_t>(height)});
+    }
+}
 
 void VulkanApp::on_char([[maybe_unused]] unsigned int codepoint)
 {}
@@ -2,10 +2,41 @@
 
 class VulkanEngine;
 
+struct AppOptions
+{
+    std::uint32_t frames_in_flight{2};
+    bool indirect{false};
+    bool instanced{false};
+    std::uint32_t object_count{1};
+    std::optional<std::uint32_t> worker_count;
+    bool optimise_meshes{false};
+    // Model to render instead of the default one.
+    std::optional<std::filesystem::path> model_path;
+    bool release_geometry{false};
+    bool parallel_recording{false};
+
+    // FIFO is always available and is used whenever the requested mode isn't.
+    vk::PresentModeKHR present_mode{vk::PresentModeKHR::eFifo};
+    // 0 leaves the choice to the swapchain builder.
+    std::uint32_t swapchain_image_count{0};
+    // Delay the start of each frame so it finishes just in time to be presented.
+    bool frame_pacing{false};
+
+    // Render without a window. Since there's no way to close it, headless runs always
+    // stop after frame_count frames (at least one).
+    bool headless{false};
+    // Number of frames to render before exiting, 0 runs until the window is closed.
+    std::uint32_t frame_count{0};
+    // Where to write the last frame that was rendered. Headless only.
+    std::optional<std::filesystem::path> capture_path;
+    // Where to write the profiler's Chrome trace on exit.
+    std::optional<std::filesystem::path> trace_path;
+};
+
 class VulkanApp
 {
 public:
-    VulkanApp();
+    VulkanApp(AppOptions const& options = {});
     ~VulkanApp();
 
     void run();
@@ -19,6 +50,9 @@ private:
     void on_char(unsigned int codepoint);
     void on_close();
 
+    void create_window();
+
+    AppOptions m_options;
     GLFWwindow* m_window{nullptr};
     std::unique_ptr<VulkanEngine> m_engine;
 };
@@ -1,30 +1,17 @@
 #include "vulkan_engine.hpp"
+#include "allocation_counter.hpp"
+#include "process_memory.hpp"
+#include "shaders/bindings.h"
+#include "vk_descriptors.hpp"
 #include "vk_initialisers.hpp"
+#include "vk_pipeline_cache.hpp"
 #include "vk_types.hpp"
 
 #include <zeus/assert.hpp>
 
-// Convert from a pointer to a vk::raii object to the corresponding vk:: object.
-template<typename T>
-auto to_vk_type(T const& ptr)
+static std::filesystem::path get_pipeline_cache_path()
 {
-    return *(*ptr);
-}
-
-// Convert a vk:: type pointer to a pointer of the corresponding vk type (C-version)
-template<typename T>
-auto to_vkc_ptr(T* ptr)
-{
-    return reinterpret_cast<T::NativeType*>(ptr);
-}
-
-// Convert a vk:: flag bit type into the corresponding vk flag type (C-Version)
-template<typename T>
-auto to_vkc_flag(T flag_bits)
-{
-    using FlagType   = vk::Flags<T>;
-    using VkFlagType = FlagType::MaskType;
-    return static_cast<VkFlagType>(FlagType{flag_bits});
+    return std::filesystem::current_path() / "pipeline_cache.bin";
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL
@@ -45,13 +32,34 @@ debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT severity,
     return 0;
 }
 
+// Dynamic state isn't inherited by secondary command buffers, so this has to be called on
+// every command buffer that draws, not just the primary.
+static void set_viewport_and_scissor(vk::raii::CommandBuffer const& cmd,
+                                     vk::Extent2D extent)
+{
+    vk::Viewport viewport{.x        = 0.0f,
+                          .y        = 0.0f,
+                          .width    = static_cast<float>(extent.width),
+                          .height   = static_cast<float>(extent.height),
+                          .minDepth = 0.0f,
+                          .maxDepth = 1.0f};
+    vk::Rect2D scissor{.offset = vk::Offset2D{0, 0}, .extent = extent};
+
+    cmd.setViewport(0, {viewport});
+    cmd.setScissor(0, {scissor});
+}
+
 vk::raii::Pipeline PipelineBuilder::build_pipeline(vk::raii::Device const& device,
+                                                   vk::raii::PipelineCache const& cache,
                                                    vk::RenderPass pass)
 {
     vk::PipelineViewportStateCreateInfo viewport_state{.viewportCount = 1,
-                                                       .pViewports    = &viewport,
-                                                       .scissorCount  = 1,
-                                                       .pScissors     = &scissor};
+                                                       .scissorCount  = 1};
+
+    std::array dynamic_states = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamic_state{
+        .dynamicStateCount = static_cast<std::uint32_t>(dynamic_states.size()),
+        .pDynamicStates    = dynamic_states.data()};
 
     vk::PipelineColorBlendStateCreateInfo colour_blending{.logicOpEnable = VK_FALSE,
                                                           .logicOp = vk::LogicOp::eCopy,
@@ -69,22 +77,131 @@ vk::raii::Pipeline PipelineBuilder::build_pipeline(vk::raii::Device const& devic
         .pMultisampleState   = &multisampling,
         .pDepthStencilState  = &depht_stencil,
         .pColorBlendState    = &colour_blending,
+        .pDynamicState       = &dynamic_state,
         .layout              = pipeline_layout,
         .renderPass          = pass,
         .subpass             = 0,
         .basePipelineHandle  = VK_NULL_HANDLE};
 
-    vk::PipelineCacheCreateInfo cache_info = {};
-
-    vk::raii::PipelineCache cache{device, cache_info};
     return vk::raii::Pipeline{device, cache, pipeline_info};
 }
 
+void FrameTimer::tick(DrawStats const& stats, std::uint64_t allocations)
+{
+    auto now = Clock::now();
+    if (last_frame == Clock::time_point{})
+    {
+        // Nothing to measure against on the very first frame.
+        last_frame  = now;
+        last_report = now;
+        return;
+    }
+
+    accumulated_ms +=
+        std::chrono::duration<double, std::milli>(now - last_frame).count();
+    last_frame = now;
+    accumulated_stats += stats;
+    accumulated_allocations += allocations;
+    ++frame_count;
+
+    if (now - last_report >= report_interval)
+    {
+        double avg_ms = accumulated_ms / frame_count;
+        fmt::print("frame time: {:.3f} ms ({:.1f} fps), per frame: {} draws, {} pipeline "
+                   "binds, {} descriptor binds",
+                   avg_ms,
+                   1000.0 / avg_ms,
+                   accumulated_stats.draws / frame_count,
+                   accumulated_stats.pipeline_binds / frame_count,
+                   accumulated_stats.descriptor_binds / frame_count);
+        if (allocation_counter::is_enabled())
+        {
+            fmt::print(", {:.1f} heap allocations",
+                       static_cast<double>(accumulated_allocations) / frame_count);
+        }
+        fmt::print("\n");
+
+        accumulated_ms          = 0.0;
+        accumulated_stats       = {};
+        accumulated_allocations = 0;
+        frame_count             = 0;
+        last_report             = now;
+    }
+}
+
+void FramePacer::wait()
+{
+    // Nothing to predict from until we've seen a couple of frames.
+    if (interval_ms > 0.0)
+    {
+        auto lead_ms = std::max(interval_ms - work_ms - safety_margin_ms, 0.0);
+        auto target  = last_end
+                      + std::chrono::duration_cast<Clock::duration>(
+                          std::chrono::duration<double, std::milli>(lead_ms));
+        if (target > Clock::now())
+        {
+            std::this_thread::sleep_until(target);
+        }
+    }
+
+    frame_start = Clock::now();
+}
+
+void FramePacer::end_frame(Clock::duration blocked)
+{
+    auto now = Clock::now();
+
+    auto work =
+        std::chrono::duration<double, std::milli>(now - frame_start - blocked).count();
+    work_ms = work_ms == 0.0 ? work : work_ms + (work - work_ms) * smoothing;
+
+    if (last_end != Clock::time_point{})
+    {
+        auto interval = std::chrono::duration<double, std::milli>(now - last_end).count();
+        interval_ms   = interval_ms == 0.0
+                            ? interval
+                            : interval_ms + (interval - interval_ms) * smoothing;
+    }
+
+    last_end = now;
+}
+
 VulkanEngine::~VulkanEngine()
 {
-    [[maybe_unused]] auto val =
-        m_device->waitForFences({to_vk_type(m_render_fence)}, true, 1000000000);
+    // Wait for every frame and upload that may still be in flight before we start
+    // tearing things down. Waiting on the last value each queue handed out covers
+    // everything that was submitted to it.
+    if (m_device)
+    {
+        m_graphics_queue.timeline.wait_idle();
+        if (m_transfer_queue)
+        {
+            m_transfer_queue->timeline.wait_idle();
+        }
+    }
+
+    if (!m_frames.empty())
+    {
+        m_profiler.resolve_all();
+        m_profiler.print_summary();
+        if (m_cull_time_ms > 0.0)
+        {
+            fmt::print("cpu culling ({}): {:.0f} spheres/ms\n",
+                       culling::get_simd_name(),
+                       static_cast<double>(m_cull_tested_count) / m_cull_time_ms);
+        }
+        if (m_trace_path)
+        {
+            m_profiler.write_chrome_trace(*m_trace_path);
+        }
+    }
 
+    if (m_pipeline_cache)
+    {
+        vk_pipeline_cache::save(*m_pipeline_cache, get_pipeline_cache_path());
+    }
+
+    m_resource_queue.flush_all();
     m_deletion_queue.flush();
 
     vmaDestroyAllocator(m_allocator);
@@ -100,17 +217,218 @@ void VulkanEngine::set_window_extent(vk::Extent2D extent)
     m_window_extent = extent;
 }
 
+void VulkanEngine::set_frames_in_flight(std::uint32_t count)
+{
+    // This has to be set before init() is called, since it determines how many of each
+    // per-frame resource we create.
+    ASSERT(m_frames.empty());
+    ASSERT(count > 0);
+    m_frames_in_flight = count;
+}
+
+void VulkanEngine::set_render_mode(RenderMode mode)
+{
+    ASSERT(m_frames.empty());
+    m_render_mode = mode;
+}
+
+void VulkanEngine::set_object_count(std::uint32_t count)
+{
+    ASSERT(m_frames.empty());
+    ASSERT(count > 0);
+    m_object_count = count;
+}
+
+void VulkanEngine::set_worker_count(std::uint32_t count)
+{
+    // This is the number of threads on top of the main one, so 0 means everything runs
+    // on the calling thread.
+    ASSERT(m_frames.empty());
+    m_worker_count = count;
+}
+
+void VulkanEngine::set_optimise_meshes(bool optimise)
+{
+    ASSERT(m_frames.empty());
+    m_optimise_meshes = optimise;
+}
+
+void VulkanEngine::set_model_path(std::filesystem::path const& path)
+{
+    ASSERT(m_frames.empty());
+    m_model_path = path;
+}
+
+void VulkanEngine::set_release_geometry(bool release)
+{
+    ASSERT(m_frames.empty());
+    m_release_geometry = release;
+}
+
+void VulkanEngine::set_parallel_recording(bool parallel)
+{
+    ASSERT(m_frames.empty());
+    m_parallel_recording = parallel;
+}
+
+void VulkanEngine::set_present_mode(vk::PresentModeKHR mode)
+{
+    ASSERT(m_frames.empty());
+    m_present_mode = mode;
+}
+
+void VulkanEngine::set_swapchain_image_count(std::uint32_t count)
+{
+    ASSERT(m_frames.empty());
+    m_swapchain_image_count = count;
+}
+
+void VulkanEngine::set_frame_pacing(bool pacing)
+{
+    ASSERT(m_frames.empty());
+    m_frame_pacing = pacing;
+}
+
+void VulkanEngine::set_headless(bool headless)
+{
+    ASSERT(m_frames.empty());
+    m_headless = headless;
+}
+
+void VulkanEngine::set_trace_path(std::filesystem::path const& path)
+{
+    m_trace_path = path;
+}
+
+void VulkanEngine::resize(vk::Extent2D extent)
+{
+    // The offscreen images in headless mode never change size.
+    if (m_headless)
+    {
+        return;
+    }
+
+    m_pending_extent  = extent;
+    m_swapchain_dirty = true;
+}
+
+void VulkanEngine::request_capture(std::filesystem::path const& path)
+{
+    if (!m_headless)
+    {
+        fmt::print("warning: frame capture is only supported in headless mode\n");
+        return;
+    }
+
+    m_capture_path = path;
+}
+
 void VulkanEngine::init()
 {
-    init_vulkan();
-    init_swapchain();
-    init_commands();
-    init_default_render_pass();
-    init_framebuffers();
-    init_sync_structures();
-    init_pipelines();
+    using Clock = std::chrono::steady_clock;
+
+    // Keep track of how long each stage takes so we can see where startup time goes.
+    std::vector<std::pair<std::string_view, double>> timings;
+    auto timed = [&timings](std::string_view name, auto&& stage) {
+        auto start = Clock::now();
+        stage();
+        auto elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start);
+        timings.emplace_back(name, elapsed.count());
+    };
+
+    timed("init_vulkan", [this]() {
+        init_vulkan();
+    });
+    timed("init_pipeline_cache", [this]() {
+        init_pipeline_cache();
+    });
+    timed("init_swapchain", [this]() {
+        if (m_headless)
+        {
+            init_offscreen_images();
+        }
+        else
+        {
+            init_swapchain();
+        }
+        init_depth_image();
+    });
+    timed("init_commands", [this]() {
+        init_commands();
+    });
+    timed("init_profiler", [this]() {
+        init_profiler();
+    });
+    timed("init_default_render_pass", [this]() {
+        init_default_render_pass();
+    });
+    timed("init_framebuffers", [this]() {
+        init_framebuffers();
+    });
+    timed("init_sync_structures", [this]() {
+        init_sync_structures();
+    });
+    timed("init_upload_context", [this]() {
+        init_upload_context();
+        if (m_headless)
+        {
+            init_readback_buffer();
+        }
+    });
+    timed("init_thread_pool", [this]() {
+        init_thread_pool();
+    });
+    timed("init_pipelines", [this]() {
+        init_descriptors();
+        if (m_render_mode == RenderMode::eIndirect)
+        {
+            init_indirect_descriptors();
+        }
+        else if (m_render_mode == RenderMode::eInstanced)
+        {
+            init_instanced_descriptors();
+        }
+        init_textures();
+        init_pipelines();
+    });
+    timed("load_meshes", [this]() {
+        load_meshes();
+        init_scene();
+        if (m_render_mode == RenderMode::eIndirect)
+        {
+            init_object_buffer();
+            init_indirect_buffers();
+        }
+        else if (m_render_mode == RenderMode::eDirect)
+        {
+            init_object_buffer();
+        }
+        else if (m_render_mode == RenderMode::eInstanced)
+        {
+            init_instance_buffers();
+        }
+
+        // Everything the scene needs goes out in a single submission.
+        m_scene_upload_value = m_upload_context.submit();
+    });
 
-    load_meshes();
+    double total{0.0};
+    fmt::print("startup timings:\n");
+    for (auto const& [name, ms] : timings)
+    {
+        fmt::print("    {:<26}{:>10.3f} ms\n", name, ms);
+        total += ms;
+    }
+    fmt::print("    {:<26}{:>10.3f} ms\n", "total", total);
+}
+
+void VulkanEngine::wait_for_next_frame()
+{
+    if (m_frame_pacing)
+    {
+        auto scope = m_profiler.cpu_scope("pace");
+        m_frame_pacer.wait();
+    }
 }
 
 void VulkanEngine::render()
@@ -120,15 +438,96 @@ void VulkanEngine::render()
     // that it will work).
     vk::Result result;
 
-    result = m_device->waitForFences({to_vk_type(m_render_fence)}, true, 1000000000);
-    m_device->resetFences({to_vk_type(m_render_fence)});
+    m_profiler.begin_frame(m_frame_number);
+    auto allocations = allocation_counter::get_count();
+
+    // Only wait for the frame that last used this slot, which is the oldest one in
+    // flight. Any other frames can keep running on the GPU while we record this one.
+    auto& frame = get_current_frame();
+
+    // Time spent waiting on the GPU or the swapchain, which the frame pacer needs to
+    // tell apart from actual work.
+    using Clock = FramePacer::Clock;
+    Clock::duration blocked{};
 
+    {
+        auto scope = m_profiler.cpu_scope("wait_frame");
+        auto start = Clock::now();
+        m_graphics_queue.timeline.wait(frame.timeline_value);
+        blocked += Clock::now() - start;
+    }
+
+    // The GPU is done with everything this frame used last time around, so it's safe to
+    // release anything that was retired up to then. That includes whatever was recorded
+    // from the frame's arena.
+    m_resource_queue.flush(get_completed_value());
+    frame.arena->reset();
+
+    // Geometry has to be resident before we draw with it. After the first frame this
+    // returns immediately.
+    m_upload_context.wait(m_scene_upload_value);
+
+    auto frame_slot = get_current_frame_slot();
+
+    if (m_swapchain_dirty)
+    {
+        // Nothing can be rendered while the window is minimised, so hold off until it
+        // has a size again.
+        if (m_pending_extent.width == 0 || m_pending_extent.height == 0)
+        {
+            return;
+        }
+
+        recreate_swapchain();
+    }
+
+    // Covers everything from asking for an image to handing it back, which is as close
+    // to the latency of the frame as we can get without present timing extensions.
+    std::optional<Profiler::CpuScope> latency_scope;
+
+    // Offscreen images are tied to the frame that renders into them, so there's nothing
+    // to acquire.
     std::uint32_t swapchain_image_idx;
-    std::tie(result, swapchain_image_idx) =
-        m_swapchain.handle->acquireNextImage(1000000000, to_vk_type(m_present_semaphore));
+    if (m_headless)
+    {
+        swapchain_image_idx =
+            static_cast<std::uint32_t>(m_frame_number % m_swapchain.images.size());
+    }
+    else
+    {
+        latency_scope.emplace(m_profiler, "latency");
+
+        auto scope = m_profiler.cpu_scope("acquire");
+        auto start = Clock::now();
+        try
+        {
+            std::tie(result, swapchain_image_idx) =
+                m_swapchain.handle->acquireNextImage(1000000000,
+                                                     to_vk_type(frame.present_semaphore));
+            blocked += Clock::now() - start;
+        }
+        catch (vk::OutOfDateKHRError const&)
+        {
+            // Nothing has been submitted for this slot yet, so simply skipping the frame
+            // leaves it ready to go again once the swapchain has been rebuilt.
+            m_pending_extent  = m_window_extent;
+            m_swapchain_dirty = true;
+            return;
+        }
+
+        // A suboptimal swapchain can still be presented to, so finish this frame and
+        // rebuild before the next one.
+        if (result == vk::Result::eSuboptimalKHR)
+        {
+            m_pending_extent  = m_window_extent;
+            m_swapchain_dirty = true;
+        }
+    }
+
+    auto record_scope = m_profiler.cpu_scope("record");
 
     // Grab the command buffer so we can use it directly.
-    auto const& cmd = m_command_pool.command_buffers.front();
+    auto const& cmd = frame.command_pool.command_buffers.front();
 
     cmd.reset();
 
@@ -136,6 +535,82 @@ void VulkanEngine::render()
         .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit};
     cmd.begin(cmd_begin_info);
 
+    m_profiler.begin_gpu_frame(frame_slot, cmd);
+
+    // Whatever the upload queue has handed over since the last frame has to be taken
+    // over before anything uses it, the textures below included.
+    auto upload_value = m_upload_context.record_acquires(cmd);
+
+    // This frame's texture set isn't in use any more either, so any textures that have
+    // finished loading since it was last used can be swapped in.
+    {
+        auto scope = m_profiler.cpu_scope("textures");
+        m_textures.update(frame_slot, cmd, *frame.arena);
+    }
+
+    // The whole scene spins around the Y axis, so fold that into the camera. This keeps
+    // the per-instance transforms static, which is what lets the indirect path skip any
+    // per-frame work on the CPU.
+    glm::vec3 cam_pos    = {0.0f, -m_scene_extent * 0.5f, -2.0f - m_scene_extent};
+    glm::mat4 view       = glm::translate(glm::mat4(1.0f), cam_pos);
+    glm::mat4 projection = glm::perspective(glm::radians(70.0f),
+                                            static_cast<float>(m_window_extent.width)
+                                                / m_window_extent.height,
+                                            0.1f,
+                                            200.0f + m_scene_extent * 2.0f);
+    projection[1][1] *= -1;
+    glm::mat4 spin = glm::rotate(glm::mat4(1.0f),
+                                 glm::radians(m_frame_number * 0.4f),
+                                 glm::vec3(0, 1, 0));
+
+    glm::mat4 view_proj = projection * view * spin;
+
+    auto scene_offset = update_scene_data(frame_slot,
+                                          GpuSceneData{.view       = view * spin,
+                                                       .projection = projection,
+                                                       .view_proj  = view_proj});
+
+    {
+        // Nothing moves at the moment, so after the first frame this is just a couple of
+        // flag checks. The instanced path writes its transforms every frame anyway, so
+        // it only needs the culling to catch up.
+        auto scope   = m_profiler.cpu_scope("scene");
+        bool updated = m_scene.update() > 0;
+        bool sorted  = m_scene.sort();
+        if (updated || sorted)
+        {
+            if (m_render_mode != RenderMode::eIndirect)
+            {
+                update_cull_spheres();
+            }
+            if (m_render_mode != RenderMode::eInstanced)
+            {
+                update_object_buffer(frame_slot, cmd);
+            }
+        }
+    }
+
+    // Stays empty in indirect mode, where the culling happens on the GPU.
+    std::pmr::vector<std::uint32_t> visible{frame.arena.get()};
+    if (m_render_mode != RenderMode::eIndirect)
+    {
+        auto scope = m_profiler.cpu_scope("cull");
+        cull_objects(view_proj, visible);
+    }
+
+    if (m_render_mode == RenderMode::eInstanced)
+    {
+        auto scope = m_profiler.cpu_scope("update_instances");
+        update_instances(frame_slot, visible);
+    }
+
+    // Culling has to happen outside of the render pass.
+    if (m_render_mode == RenderMode::eIndirect)
+    {
+        auto gpu_scope = m_profiler.gpu_scope(cmd, "cull");
+        record_cull_pass(cmd, view_proj);
+    }
+
     float flash = std::abs(std::sin(m_frame_number / 120.0f));
     vk::ClearValue colour_clear{.color = {std::array{0.0f, 0.0f, flash, 1.0f}}};
 
@@ -151,65 +626,572 @@ void VulkanEngine::render()
         .pClearValues    = clear_values.data()
     };
 
-    cmd.beginRenderPass(rp_info, vk::SubpassContents::eInline);
+    DrawStats draw_stats;
+    {
+        // With parallel recording the draws all come from secondary command buffers, so
+        // the only thing the primary can do inside the pass is execute them.
+        bool parallel = !frame.worker_pools.empty();
+        auto contents = parallel ? vk::SubpassContents::eSecondaryCommandBuffers
+                                 : vk::SubpassContents::eInline;
+
+        auto gpu_scope = m_profiler.gpu_scope(cmd, "render_pass");
+        cmd.beginRenderPass(rp_info, contents);
+
+        if (m_render_mode == RenderMode::eIndirect)
+        {
+            draw_stats = draw_indirect(cmd, scene_offset);
+        }
+        else if (m_render_mode == RenderMode::eInstanced)
+        {
+            draw_stats = draw_instanced(cmd, frame_slot, scene_offset, visible);
+        }
+        else if (parallel)
+        {
+            draw_stats = record_direct_parallel(frame,
+                                                cmd,
+                                                rp_info.framebuffer,
+                                                scene_offset,
+                                                visible);
+        }
+        else
+        {
+            draw_stats = draw_direct(cmd, scene_offset, visible);
+        }
+
+        cmd.endRenderPass();
+    }
 
-    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, to_vk_type(m_mesh_pipeline));
+    if (m_capture_path)
+    {
+        record_capture(cmd, m_swapchain.images[swapchain_image_idx]);
+    }
 
-    glm::vec3 cam_pos    = {0.0f, 0.0f, -2.0f};
-    glm::mat4 view       = glm::translate(glm::mat4(1.0f), cam_pos);
-    glm::mat4 projection = glm::perspective(glm::radians(70.0f),
-                                            static_cast<float>(m_window_extent.width)
-                                                / m_window_extent.height,
-                                            0.1f,
-                                            200.0f);
-    projection[1][1] *= -1;
-    glm::mat4 model = glm::rotate(glm::mat4(1.0f),
-                                  glm::radians(m_frame_number * 0.4f),
-                                  glm::vec3(0, 1, 0));
+    cmd.end();
+    record_scope.end();
 
-    MeshPushConstants constants;
-    constants.mvp = projection * view * model;
+    // We're going to need the address of several vk:: objects, so grab them here.
+    auto present_semaphore = to_vk_type(frame.present_semaphore);
+    auto render_semaphore  = to_vk_type(frame.render_semaphore);
+
+    // Without a swapchain there's nothing to wait on or signal for presentation, so the
+    // timeline is all we need. The acquires from the upload queue have to wait for the
+    // releases, which have already happened, so that wait never holds anything up.
+    std::array<QueueTimeline::Wait, 2> wait_storage;
+    std::size_t wait_count{0};
+    if (!m_headless)
+    {
+        wait_storage[wait_count++] = QueueTimeline::Wait{
+            .semaphore = present_semaphore,
+            .stage     = vk::PipelineStageFlagBits::eColorAttachmentOutput};
+    }
+    if (upload_value != 0)
+    {
+        wait_storage[wait_count++] =
+            QueueTimeline::Wait{.semaphore = get_upload_queue().timeline.get_semaphore(),
+                                .value     = upload_value,
+                                .stage     = vk::PipelineStageFlagBits::eAllCommands};
+    }
+    std::span<QueueTimeline::Wait const> waits{wait_storage.data(), wait_count};
 
-    // Draw each mesh in the model.
+    {
+        auto scope           = m_profiler.cpu_scope("submit");
+        frame.timeline_value = m_graphics_queue.timeline.submit(
+            *cmd,
+            waits,
+            m_headless ? vk::Semaphore{} : render_semaphore);
+    }
+    m_profiler.mark_submit();
+
+    if (!m_headless)
+    {
+        auto scope     = m_profiler.cpu_scope("present");
+        auto swapchain = to_vk_type(m_swapchain.handle);
+
+        vk::PresentInfoKHR present_info{.waitSemaphoreCount = 1,
+                                        .pWaitSemaphores    = &render_semaphore,
+                                        .swapchainCount     = 1,
+                                        .pSwapchains        = &swapchain,
+                                        .pImageIndices      = &swapchain_image_idx};
+
+        try
+        {
+            result = m_graphics_queue.queue.presentKHR(present_info);
+        }
+        catch (vk::OutOfDateKHRError const&)
+        {
+            result = vk::Result::eErrorOutOfDateKHR;
+        }
+
+        if (result != vk::Result::eSuccess && !m_swapchain_dirty)
+        {
+            m_pending_extent  = m_window_extent;
+            m_swapchain_dirty = true;
+        }
+
+        latency_scope.reset();
+    }
+
+    if (m_frame_pacing)
+    {
+        m_frame_pacer.end_frame(blocked);
+    }
+
+    if (m_capture_path)
+    {
+        // Captures are rare, so just stall until this frame is done rather than trying
+        // to pick the result up when the frame comes around again.
+        m_graphics_queue.timeline.wait(frame.timeline_value);
+        write_capture(*m_capture_path);
+        m_capture_path.reset();
+    }
+
+    ++m_frame_number;
+
+    m_frame_timer.tick(draw_stats, allocation_counter::get_count() - allocations);
+}
+
+void VulkanEngine::record_cull_pass(vk::raii::CommandBuffer const& cmd,
+                                    glm::mat4 const& view_proj)
+{
+    auto& indirect = m_indirect;
+
+    // The previous frame may still be drawing from the command and count buffers, so
+    // make sure that's done before we overwrite them.
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eDrawIndirect,
+                        vk::PipelineStageFlagBits::eTransfer
+                            | vk::PipelineStageFlagBits::eComputeShader,
+                        {},
+                        {},
+                        {},
+                        {});
+
+    cmd.fillBuffer(indirect.count_buffer.buffer, 0, sizeof(std::uint32_t), 0);
+
+    vk::MemoryBarrier clear_barrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                                    .dstAccessMask = vk::AccessFlagBits::eShaderRead
+                                                     | vk::AccessFlagBits::eShaderWrite};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eComputeShader,
+                        {},
+                        {clear_barrier},
+                        {},
+                        {});
+
+    auto layout = to_vk_type(indirect.cull_pipeline_layout);
+
+    auto frustum = culling::extract_frustum_planes(view_proj);
+    CullPushConstants constants{.frustum_planes = frustum,
+                                .object_count   = indirect.object_count};
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, to_vk_type(indirect.cull_pipeline));
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute,
+                           layout,
+                           0,
+                           {indirect.descriptor_set},
+                           {});
+    cmd.pushConstants<CullPushConstants>(layout,
+                                         vk::ShaderStageFlagBits::eCompute,
+                                         0,
+                                         {constants});
+
+    std::uint32_t group_count =
+        (indirect.object_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE;
+    cmd.dispatch(group_count, 1, 1);
+
+    vk::MemoryBarrier cull_barrier{.srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                                   .dstAccessMask =
+                                       vk::AccessFlagBits::eIndirectCommandRead};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eDrawIndirect,
+                        {},
+                        {cull_barrier},
+                        {},
+                        {});
+}
+
+void VulkanEngine::cull_objects(glm::mat4 const& view_proj,
+                                std::pmr::vector<std::uint32_t>& visible)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Growing one push at a time would leave every smaller copy behind in the arena.
+    visible.reserve(m_cull_spheres.size());
+    culling::cull_spheres(m_cull_spheres,
+                          culling::extract_frustum_planes(view_proj),
+                          visible);
+
+    m_cull_time_ms += std::chrono::duration<double, std::milli>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    m_cull_tested_count += m_cull_spheres.size();
+}
+
+void VulkanEngine::update_object_buffer(std::uint32_t slot,
+                                        vk::raii::CommandBuffer const& cmd)
+{
+    // The draw order only ever gets shuffled, objects aren't added once the scene is
+    // up, so the buffer is still the right size.
+    auto const& staging = m_object_staging_buffers[slot];
+    std::span objects{static_cast<GpuObjectData*>(staging.mapped_data),
+                      m_scene.get_draw_order().size()};
+    write_object_data(objects);
+    vmaFlushAllocation(m_allocator, staging.allocation, 0, objects.size_bytes());
+
+    // The frames still in flight may be reading the old contents, but they were all
+    // submitted to this queue earlier, so the barrier holds the copy back until they're
+    // done with it.
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eVertexShader
+                            | vk::PipelineStageFlagBits::eComputeShader,
+                        vk::PipelineStageFlagBits::eTransfer,
+                        {},
+                        {},
+                        {},
+                        {});
+
+    vk::BufferCopy region{.srcOffset = 0, .dstOffset = 0, .size = objects.size_bytes()};
+    cmd.copyBuffer(staging.buffer, m_object_buffer.buffer, {region});
+
+    vk::MemoryBarrier copy_barrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                                   .dstAccessMask = vk::AccessFlagBits::eShaderRead};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eVertexShader
+                            | vk::PipelineStageFlagBits::eComputeShader,
+                        {},
+                        {copy_barrier},
+                        {},
+                        {});
+}
+
+std::uint32_t VulkanEngine::update_scene_data(std::uint32_t slot,
+                                              GpuSceneData const& data)
+{
+    auto offset = slot * m_scene_stride;
+    std::memcpy(static_cast<std::byte*>(m_scene_buffer.mapped_data) + offset,
+                &data,
+                sizeof(GpuSceneData));
+
+    // Host-visible memory isn't guaranteed to be coherent.
+    vmaFlushAllocation(m_allocator,
+                       m_scene_buffer.allocation,
+                       offset,
+                       sizeof(GpuSceneData));
+
+    return static_cast<std::uint32_t>(offset);
+}
+
+void VulkanEngine::bind_descriptor_sets(vk::raii::CommandBuffer const& cmd,
+                                        vk::PipelineLayout layout,
+                                        vk::DescriptorSet object_set,
+                                        std::uint32_t scene_offset)
+{
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics,
+                           layout,
+                           GLOBAL_SET,
+                           {m_global_set,
+                            object_set,
+                            m_textures.get_set(get_current_frame_slot())},
+                           {scene_offset});
+}
+
+DrawStats VulkanEngine::draw_direct(vk::raii::CommandBuffer const& cmd,
+                                    std::uint32_t scene_offset,
+                                    std::span<std::uint32_t const> objects)
+{
+    auto layout = to_vk_type(m_mesh_pipeline_layout);
+    DrawStats stats;
+
+    // The material pipelines all share the layout, so the sets only have to be bound
+    // once no matter how many times the pipeline changes.
+    set_viewport_and_scissor(cmd, m_window_extent);
+    bind_descriptor_sets(cmd, layout, m_object_set, scene_offset);
+    ++stats.descriptor_binds;
+
+    // Every mesh in the model shares the same buffers, so bind them once and then just
+    // draw each range.
     vk::DeviceSize offset = 0;
-    for (auto& mesh : m_model.meshes)
+    cmd.bindVertexBuffers(0, {m_model.vertex_buffer.buffer}, {offset});
+    cmd.bindIndexBuffer(m_model.index_buffer.buffer, offset, vk::IndexType::eUint32);
+
+    // The matrices all live on the GPU, so all each draw needs is where its object is in
+    // the object buffer, which is its position in the draw order. The draw order is
+    // sorted by pipeline first, so the pipeline changes at most once per material
+    // pipeline. The textures are indexed from the object buffer, so changing material
+    // within a pipeline doesn't need any binds at all.
+    auto draw_order = m_scene.get_draw_order();
+    auto bound      = Scene::max_pipeline + 1;
+    for (auto index : objects)
     {
-        cmd.bindVertexBuffers(0, {mesh.vertex_buffer.buffer}, {offset});
-        cmd.bindIndexBuffer(mesh.index_buffer.buffer, offset, vk::IndexType::eUint32);
-        cmd.pushConstants<MeshPushConstants>(to_vk_type(m_mesh_pipeline_layout),
+        auto object   = draw_order[index];
+        auto pipeline = m_scene.get_pipeline(object);
+        if (pipeline != bound)
+        {
+            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                             to_vk_type(m_mesh_pipelines[pipeline]));
+            bound = pipeline;
+            ++stats.pipeline_binds;
+        }
+
+        MeshPushConstants constants{.object_index = index};
+        cmd.pushConstants<MeshPushConstants>(layout,
                                              vk::ShaderStageFlagBits::eVertex,
                                              0,
                                              {constants});
-        cmd.drawIndexed(static_cast<std::uint32_t>(mesh.indices.size()), 1, 0, 0, 0);
+
+        auto const& mesh = m_model.meshes[m_scene.get_mesh(object)];
+        cmd.drawIndexed(mesh.index_count, 1, mesh.first_index, mesh.vertex_offset, 0);
+        ++stats.draws;
     }
 
-    cmd.endRenderPass();
-    cmd.end();
+    return stats;
+}
 
-    // We're going to need the address of several vk:: objects, so grab them here.
-    auto present_semaphore = to_vk_type(m_present_semaphore);
-    auto render_semaphore  = to_vk_type(m_render_semaphore);
-    auto swapchain         = to_vk_type(m_swapchain.handle);
-
-    vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-    vk::SubmitInfo submit{.waitSemaphoreCount   = 1,
-                          .pWaitSemaphores      = &present_semaphore,
-                          .pWaitDstStageMask    = &wait_stage,
-                          .commandBufferCount   = 1,
-                          .pCommandBuffers      = &(*cmd),
-                          .signalSemaphoreCount = 1,
-                          .pSignalSemaphores    = &render_semaphore};
-
-    m_graphics_queue.queue.submit({submit}, to_vk_type(m_render_fence));
-
-    vk::PresentInfoKHR present_info{.waitSemaphoreCount = 1,
-                                    .pWaitSemaphores    = &render_semaphore,
-                                    .swapchainCount     = 1,
-                                    .pSwapchains        = &swapchain,
-                                    .pImageIndices      = &swapchain_image_idx};
-
-    result = m_graphics_queue.queue.presentKHR(present_info);
-    ++m_frame_number;
+DrawStats VulkanEngine::record_direct_parallel(FrameData& frame,
+                                               vk::raii::CommandBuffer const& cmd,
+                                               vk::Framebuffer framebuffer,
+                                               std::uint32_t scene_offset,
+                                               std::span<std::uint32_t const> objects)
+{
+    // Use as many tasks as we have pools for, as long as each one still gets a
+    // worthwhile amount of work.
+    std::size_t task_count =
+        (objects.size() + min_objects_per_task - 1) / min_objects_per_task;
+    task_count = std::clamp<std::size_t>(task_count, 1, frame.worker_pools.size());
+    std::size_t objects_per_task = (objects.size() + task_count - 1) / task_count;
+
+    vk::CommandBufferInheritanceInfo inheritance_info{.renderPass =
+                                                          to_vk_type(m_render_pass),
+                                                      .subpass     = 0,
+                                                      .framebuffer = framebuffer};
+    vk::CommandBufferBeginInfo begin_info{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit
+                 | vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+        .pInheritanceInfo = &inheritance_info};
+
+    // Each secondary starts with no state bound, so every task pays for its own binds.
+    // The tasks only write to their own element, so the vector itself is never touched
+    // off this thread.
+    std::pmr::vector<DrawStats> task_stats(task_count, frame.arena.get());
+    m_thread_pool->parallel_for(task_count, [&](std::size_t i) {
+        auto scope = m_profiler.cpu_scope("record_task");
+
+        // The frame has been waited on, so nothing from the last time around can still be
+        // using the pool. Resetting the whole pool is cheaper than resetting the buffer
+        // on its own.
+        auto& pool = frame.worker_pools[i];
+        pool.pool->reset();
+
+        auto first = std::min(i * objects_per_task, objects.size());
+        auto count = std::min(objects_per_task, objects.size() - first);
+
+        auto const& secondary = pool.command_buffers.front();
+        secondary.begin(begin_info);
+        task_stats[i] =
+            draw_direct(secondary, scene_offset, objects.subspan(first, count));
+        secondary.end();
+    });
+
+    DrawStats stats;
+    std::pmr::vector<vk::CommandBuffer> secondaries(task_count, frame.arena.get());
+    for (std::size_t i{0}; i < task_count; ++i)
+    {
+        secondaries[i] = *frame.worker_pools[i].command_buffers.front();
+        stats += task_stats[i];
+    }
+
+    cmd.executeCommands(secondaries);
+    return stats;
+}
+
+DrawStats VulkanEngine::draw_indirect(vk::raii::CommandBuffer const& cmd,
+                                      std::uint32_t scene_offset)
+{
+    auto& indirect = m_indirect;
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                     to_vk_type(indirect.draw_pipeline));
+    set_viewport_and_scissor(cmd, m_window_extent);
+    bind_descriptor_sets(cmd,
+                         to_vk_type(indirect.draw_pipeline_layout),
+                         indirect.descriptor_set,
+                         scene_offset);
+
+    vk::DeviceSize offset = 0;
+    cmd.bindVertexBuffers(0, {m_model.vertex_buffer.buffer}, {offset});
+    cmd.bindIndexBuffer(m_model.index_buffer.buffer, offset, vk::IndexType::eUint32);
+
+    // The draw count lives on the GPU, so no matter how many objects there are this is
+    // the only draw the CPU ever records.
+    cmd.drawIndexedIndirectCount(indirect.command_buffer.buffer,
+                                 0,
+                                 indirect.count_buffer.buffer,
+                                 0,
+                                 indirect.object_count,
+                                 sizeof(vk::DrawIndexedIndirectCommand));
+
+    // Every material goes through the textured pipeline here, since the draws are
+    // generated on the GPU. Materials without a texture just sample the white one.
+    return DrawStats{.pipeline_binds = 1, .descriptor_binds = 1, .draws = 1};
+}
+
+void VulkanEngine::update_instances(std::uint32_t slot,
+                                    std::span<std::uint32_t const> objects)
+{
+    // Only the objects that survived culling are written, packed at the front and in
+    // draw order, so the draws only need to know where each mesh's run starts.
+    auto const& buffer = m_instanced.instance_buffers[slot];
+    auto instances     = static_cast<glm::mat4*>(buffer.mapped_data);
+    auto draw_order    = m_scene.get_draw_order();
+    for (std::size_t i{0}; i < objects.size(); ++i)
+    {
+        instances[i] = m_scene.get_world_transform(draw_order[objects[i]]);
+    }
+
+    // Host-visible memory isn't guaranteed to be coherent. The submit makes the write
+    // visible to the GPU once it's flushed.
+    vmaFlushAllocation(m_allocator, buffer.allocation, 0, VK_WHOLE_SIZE);
+}
+
+DrawStats VulkanEngine::draw_instanced(vk::raii::CommandBuffer const& cmd,
+                                       std::uint32_t slot,
+                                       std::uint32_t scene_offset,
+                                       std::span<std::uint32_t const> objects)
+{
+    auto& instanced = m_instanced;
+    auto layout     = to_vk_type(instanced.pipeline_layout);
+    DrawStats stats;
+
+    set_viewport_and_scissor(cmd, m_window_extent);
+    bind_descriptor_sets(cmd, layout, instanced.descriptor_sets[slot], scene_offset);
+    ++stats.descriptor_binds;
+
+    vk::DeviceSize offset = 0;
+    cmd.bindVertexBuffers(0, {m_model.vertex_buffer.buffer}, {offset});
+    cmd.bindIndexBuffer(m_model.index_buffer.buffer, offset, vk::IndexType::eUint32);
+
+    // The draw order is sorted by pipeline, material and mesh, so every run of visible
+    // objects that share all three becomes a single draw, with firstInstance pointing at
+    // the start of the run. The number of draws only depends on the number of meshes,
+    // not on how many copies of them there are.
+    auto draw_order = m_scene.get_draw_order();
+    auto get_state  = [this, draw_order](std::uint32_t visible) {
+        auto object = draw_order[visible];
+        return std::tuple{m_scene.get_pipeline(object),
+                          m_scene.get_material(object),
+                          m_scene.get_mesh(object)};
+    };
+
+    auto bound_pipeline = Scene::max_pipeline + 1;
+    auto bound_material = Scene::max_sort_value + 1;
+    auto visible_count  = static_cast<std::uint32_t>(objects.size());
+    for (std::uint32_t first{0}; first < visible_count;)
+    {
+        auto state = get_state(objects[first]);
+        auto last  = first + 1;
+        while (last < visible_count && get_state(objects[last]) == state)
+        {
+            ++last;
+        }
+
+        auto [pipeline, material, mesh_index] = state;
+        if (pipeline != bound_pipeline)
+        {
+            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                             to_vk_type(instanced.pipelines[pipeline]));
+            bound_pipeline = pipeline;
+            ++stats.pipeline_binds;
+        }
+
+        // There's no per-object data to carry the texture, so it goes along with the
+        // draw instead.
+        if (material != bound_material)
+        {
+            InstancedPushConstants constants{.texture_index =
+                                                 m_materials[material].texture};
+            cmd.pushConstants<InstancedPushConstants>(layout,
+                                                      vk::ShaderStageFlagBits::eVertex,
+                                                      0,
+                                                      constants);
+            bound_material = material;
+        }
+
+        auto const& mesh = m_model.meshes[mesh_index];
+        cmd.drawIndexed(mesh.index_count,
+                        last - first,
+                        mesh.first_index,
+                        mesh.vertex_offset,
+                        first);
+        ++stats.draws;
+        first = last;
+    }
+
+    return stats;
+}
+
+void VulkanEngine::record_capture(vk::raii::CommandBuffer const& cmd, vk::Image image)
+{
+    // The render pass leaves the image in TransferSrcOptimal and its external dependency
+    // already orders the colour writes before this copy.
+    vk::BufferImageCopy region{
+        .bufferOffset      = 0,
+        .bufferRowLength   = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource  = {.aspectMask     = vk::ImageAspectFlagBits::eColor,
+                              .mipLevel       = 0,
+                              .baseArrayLayer = 0,
+                              .layerCount     = 1},
+        .imageOffset       = {0, 0, 0},
+        .imageExtent       = {m_window_extent.width, m_window_extent.height, 1}
+    };
+
+    cmd.copyImageToBuffer(image,
+                          vk::ImageLayout::eTransferSrcOptimal,
+                          m_readback_buffer.buffer,
+                          {region});
+
+    vk::MemoryBarrier barrier{.srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                              .dstAccessMask = vk::AccessFlagBits::eHostRead};
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+                        vk::PipelineStageFlagBits::eHost,
+                        {},
+                        {barrier},
+                        {},
+                        {});
+}
+
+void VulkanEngine::write_capture(std::filesystem::path const& path)
+{
+    auto [width, height] = m_window_extent;
+
+    // The readback buffer isn't guaranteed to be coherent.
+    vmaInvalidateAllocation(m_allocator, m_readback_buffer.allocation, 0, VK_WHOLE_SIZE);
+
+    std::ofstream stream{path, std::ios::binary};
+    if (!stream)
+    {
+        fmt::print("error: unable to write capture to {}\n", path.string());
+        return;
+    }
+
+    // Binary PPM is just a small text header followed by packed RGB, so all we need to
+    // do is drop the alpha channel.
+    auto header = fmt::format("P6\n{} {}\n255\n", width, height);
+    stream.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    auto pixels = static_cast<std::uint8_t const*>(m_readback_buffer.mapped_data);
+    std::vector<char> row(static_cast<std::size_t>(width) * 3);
+    for (std::uint32_t y{0}; y < height; ++y)
+    {
+        for (std::uint32_t x{0}; x < width; ++x)
+        {
+            auto pixel     = pixels + (static_cast<std::size_t>(y) * width + x) * 4;
+            row[x * 3 + 0] = static_cast<char>(pixel[0]);
+            row[x * 3 + 1] = static_cast<char>(pixel[1]);
+            row[x * 3 + 2] = static_cast<char>(pixel[2]);
+        }
+        stream.write(row.data(), static_cast<std::streamsize>(row.size()));
+    }
+
+    fmt::print("captured frame {} to {}\n", m_frame_number, path.string());
 }
 
 void VulkanEngine::init_vulkan()
@@ -221,6 +1203,7 @@ void VulkanEngine::init_vulkan()
                         .request_validation_layers(true)
                         .require_api_version(1, 3, 0)
                         .set_debug_callback(debug_callback)
+                        .set_headless(m_headless)
                         .build();
 
     vkb::Instance vkb_inst = inst_ret.value();
@@ -233,14 +1216,45 @@ void VulkanEngine::init_vulkan()
     // Grab the instance itself from the wrapper so we can create the surface.
     auto instance = to_vk_type(m_instance);
 
-    m_surface =
-        std::make_unique<vk::raii::SurfaceKHR>(*m_instance, m_surface_callback(instance));
+    if (!m_headless)
+    {
+        m_surface = std::make_unique<vk::raii::SurfaceKHR>(*m_instance,
+                                                           m_surface_callback(instance));
+    }
+
+    // Timeline semaphores are used to track when uploads have completed.
+    vk::PhysicalDeviceFeatures features;
+    vk::PhysicalDeviceVulkan12Features features_12;
+    features_12.timelineSemaphore = true;
+
+    // The indirect path issues many draws from one call, each with its own
+    // firstInstance, and reads the draw count from a buffer.
+    if (m_render_mode == RenderMode::eIndirect)
+    {
+        features.multiDrawIndirect         = true;
+        features.drawIndirectFirstInstance = true;
+        features_12.drawIndirectCount      = true;
+    }
+
+    // Textures are bound as one array that's indexed per draw, and most of its slots are
+    // never written.
+    features_12.runtimeDescriptorArray                    = true;
+    features_12.shaderSampledImageArrayNonUniformIndexing = true;
+    features_12.descriptorBindingPartiallyBound           = true;
 
+    // Without a surface we can't (and don't need to) check for present support, which
+    // also lets this run on software implementations like lavapipe.
     vkb::PhysicalDeviceSelector selector{vkb_inst};
-    vkb::PhysicalDevice physical_device = selector.set_minimum_version(1, 3)
-                                              .set_surface(to_vk_type(m_surface))
-                                              .select()
-                                              .value();
+    selector.set_minimum_version(1, 3)
+        .set_required_features(features)
+        .set_required_features_12(features_12)
+        .require_present(!m_headless);
+    if (!m_headless)
+    {
+        selector.set_surface(to_vk_type(m_surface));
+    }
+
+    vkb::PhysicalDevice physical_device = selector.select().value();
 
     vkb::DeviceBuilder device_builder{physical_device};
     vkb::Device vkb_device = device_builder.build().value();
@@ -263,6 +1277,34 @@ void VulkanEngine::init_vulkan()
     m_graphics_queue.family_index =
         vkb_device.get_queue_index(vkb::QueueType::graphics).value();
 
+    // vk-bootstrap prefers a family with nothing but transfer, and falls back to any
+    // family other than graphics. Textures are streamed in bands of arbitrary rows,
+    // which needs a queue that can copy to any offset.
+    auto transfer_queue = vkb_device.get_queue(vkb::QueueType::transfer);
+    auto transfer_index = vkb_device.get_queue_index(vkb::QueueType::transfer);
+    if (transfer_queue && transfer_index)
+    {
+        auto families    = m_chosen_gpu.getQueueFamilyProperties();
+        auto granularity = families[transfer_index.value()].minImageTransferGranularity;
+        if (granularity == vk::Extent3D{1, 1, 1})
+        {
+            m_transfer_queue.emplace();
+            m_transfer_queue->queue        = transfer_queue.value();
+            m_transfer_queue->family_index = transfer_index.value();
+        }
+    }
+
+    if (m_transfer_queue)
+    {
+        fmt::print("uploads: using queue family {}, separate from graphics ({})\n",
+                   m_transfer_queue->family_index,
+                   m_graphics_queue.family_index);
+    }
+    else
+    {
+        fmt::print("uploads: no separate transfer queue, sharing the graphics queue\n");
+    }
+
     VmaAllocatorCreateInfo alloc_info = {};
     alloc_info.physicalDevice         = m_chosen_gpu;
     alloc_info.device                 = to_vk_type(m_device);
@@ -271,20 +1313,47 @@ void VulkanEngine::init_vulkan()
     {
         throw std::runtime_error{"error: unable to initialise VMA"};
     }
+
+    m_resource_queue.init(m_allocator);
+}
+
+void VulkanEngine::init_pipeline_cache()
+{
+    m_pipeline_cache = vk_pipeline_cache::load(*m_device,
+                                               m_chosen_gpu.getProperties(),
+                                               get_pipeline_cache_path());
 }
 
-void VulkanEngine::init_swapchain()
+void VulkanEngine::init_swapchain(vk::SwapchainKHR old_swapchain)
 {
     vkb::SwapchainBuilder swapchain_builder{m_chosen_gpu,
                                             to_vk_type(m_device),
                                             to_vk_type(m_surface)};
 
-    vkb::Swapchain vkb_swapchain =
-        swapchain_builder.use_default_format_selection()
-            .set_desired_present_mode(VK_PRESENT_MODE_FIFO_KHR)
-            .set_desired_extent(m_window_extent.width, m_window_extent.height)
-            .build()
-            .value();
+    swapchain_builder.use_default_format_selection()
+        .set_desired_present_mode(static_cast<VkPresentModeKHR>(m_present_mode))
+        .add_fallback_present_mode(VK_PRESENT_MODE_FIFO_KHR)
+        .set_desired_extent(m_window_extent.width, m_window_extent.height)
+        .set_old_swapchain(static_cast<VkSwapchainKHR>(old_swapchain));
+    if (m_swapchain_image_count != 0)
+    {
+        swapchain_builder.set_desired_min_image_count(m_swapchain_image_count);
+    }
+
+    vkb::Swapchain vkb_swapchain = swapchain_builder.build().value();
+
+    // Only report this the first time around, rebuilding on resize gives the same thing.
+    if (!old_swapchain)
+    {
+        fmt::print("swapchain: {} images, present mode {}\n",
+                   vkb_swapchain.image_count,
+                   vk::to_string(vk::PresentModeKHR{vkb_swapchain.present_mode}));
+    }
+
+    // The surface gets the final say on the size, so everything else has to follow
+    // whatever we actually got.
+    m_window_extent = vk::Extent2D{vkb_swapchain.extent.width,
+                                   vkb_swapchain.extent.height};
 
     // Note that the swapchain is owned by the device, so by creating it like this we
     // guarantee that it will be destroyed before the device.
@@ -307,7 +1376,76 @@ void VulkanEngine::init_swapchain()
         });
 
     m_swapchain.format = vk::Format{vkb_swapchain.image_format};
+}
+
+void VulkanEngine::init_offscreen_images()
+{
+    // vk-bootstrap's default selection prefers B8G8R8A8_SRGB for the swapchain. This is
+    // the same sRGB encoding with the channels in RGBA order, so both modes produce the
+    // same output and the capture can be written out without swizzling.
+    m_swapchain.format = vk::Format::eR8G8B8A8Srgb;
+
+    vk::Extent3D extent{m_window_extent.width, m_window_extent.height, 1};
+    vk::ImageCreateInfo image_info = vk_initialisers::image_create_info(
+        m_swapchain.format,
+        vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+        extent);
+
+    VmaAllocationCreateInfo alloc_info = {};
+    alloc_info.usage                   = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.requiredFlags = to_vkc_flag(vk::MemoryPropertyFlagBits::eDeviceLocal);
+
+    // One image per frame in flight, so a frame never renders into an image the GPU may
+    // still be using for the previous one.
+    m_swapchain.offscreen_images.resize(m_frames_in_flight);
+    for (auto& image : m_swapchain.offscreen_images)
+    {
+        if (vmaCreateImage(m_allocator,
+                           to_vkc_ptr(&image_info),
+                           &alloc_info,
+                           to_vkc_ptr(&image.image),
+                           &image.allocation,
+                           nullptr)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error{"error: unable to allocate offscreen image"};
+        }
+
+        vk::ImageViewCreateInfo view_info =
+            vk_initialisers::image_view_create_info(m_swapchain.format,
+                                                    image.image,
+                                                    vk::ImageAspectFlagBits::eColor);
+
+        m_swapchain.images.push_back(image.image);
+        m_swapchain.image_views.push_back(
+            std::make_unique<vk::raii::ImageView>(*m_device, view_info));
+    }
 
+    m_deletion_queue.push_function([this]() {
+        // The views have to go before the images they reference.
+        m_swapchain.image_views.clear();
+        for (auto& image : m_swapchain.offscreen_images)
+        {
+            vmaDestroyImage(m_allocator, image.image, image.allocation);
+        }
+    });
+}
+
+void VulkanEngine::init_depth_image()
+{
+    create_depth_image();
+
+    // This always destroys whichever depth image is current at shutdown. Ones replaced
+    // when the swapchain is recreated are retired along with the old swapchain.
+    m_deletion_queue.push_function([this]() {
+        vmaDestroyImage(m_allocator,
+                        m_swapchain.depth_image.image,
+                        m_swapchain.depth_image.allocation);
+    });
+}
+
+void VulkanEngine::create_depth_image()
+{
     // Grab the depth components of the swapchain to make life easier.
     auto& depth_format     = m_swapchain.depth_format;
     auto& depth_image      = m_swapchain.depth_image;
@@ -338,31 +1476,109 @@ void VulkanEngine::init_swapchain()
                                                 depth_image.image,
                                                 vk::ImageAspectFlagBits::eDepth);
     depth_image_view = std::make_unique<vk::raii::ImageView>(*m_device, depth_view_info);
+}
 
-    m_deletion_queue.push_function([this]() {
-        vmaDestroyImage(m_allocator,
-                        m_swapchain.depth_image.image,
-                        m_swapchain.depth_image.allocation);
-    });
+void VulkanEngine::recreate_swapchain()
+{
+    auto scope = m_profiler.cpu_scope("recreate_swapchain");
+
+    // Earlier frames may still be rendering to (or presenting) the old images, so rather
+    // than waiting for the device to go idle, retire everything along with the current
+    // frame. It's freed once that frame has completed, and with it every frame that could
+    // have used the old images. This goes by frame number rather than by slot, so it
+    // still holds if this frame ends up being skipped.
+    auto old_swapchain    = std::move(m_swapchain);
+    auto old_framebuffers = std::move(m_framebuffers);
+
+    m_swapchain = Swapchain{};
+    m_framebuffers.clear();
+    m_window_extent = m_pending_extent;
+
+    init_swapchain(to_vk_type(old_swapchain.handle));
+    create_depth_image();
+    init_framebuffers();
+
+    auto retire_value = get_retire_value();
+    for (auto& framebuffer : old_framebuffers)
+    {
+        m_resource_queue.push(std::move(framebuffer), retire_value);
+    }
+    for (auto& view : old_swapchain.image_views)
+    {
+        m_resource_queue.push(std::move(*view), retire_value);
+    }
+    m_resource_queue.push(std::move(*old_swapchain.depth_image_view), retire_value);
+    m_resource_queue.push(old_swapchain.depth_image, retire_value);
+    m_resource_queue.push(std::move(*old_swapchain.handle), retire_value);
+
+    m_swapchain_dirty = false;
 }
 
 void VulkanEngine::init_commands()
 {
     using namespace vk_initialisers;
 
+    m_frames.resize(m_frames_in_flight);
+
+    // Each frame gets its own pool so we can record into one while the GPU is still
+    // consuming the others.
+    for (auto& frame : m_frames)
+    {
+        auto& command_pool = frame.command_pool;
+
+        {
+            auto info = command_pool_create_info(
+                m_graphics_queue.family_index,
+                vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+            command_pool.pool = std::make_unique<vk::raii::CommandPool>(*m_device, info);
+        }
+
+        {
+            auto info = command_buffer_allocate_info(*command_pool.pool,
+                                                     1,
+                                                     vk::CommandBufferLevel::ePrimary);
+            command_pool.command_buffers = vk::raii::CommandBuffers{*m_device, info};
+        }
+
+        frame.arena = std::make_unique<LinearArena>(frame_arena_size);
+    }
+
+    if (!m_parallel_recording)
     {
-        auto info =
-            command_pool_create_info(m_graphics_queue.family_index,
-                                     vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
-        m_command_pool.pool = std::make_unique<vk::raii::CommandPool>(*m_device, info);
+        return;
     }
 
+    if (m_render_mode != RenderMode::eDirect)
     {
-        auto info = command_buffer_allocate_info(*m_command_pool.pool,
-                                                 1,
-                                                 vk::CommandBufferLevel::ePrimary);
-        m_command_pool.command_buffers = vk::raii::CommandBuffers{*m_device, info};
+        fmt::print("warning: parallel recording only has an effect in direct mode\n");
+        return;
     }
+
+    // The calling thread takes part in parallel_for, so there can be one task per worker
+    // plus one.
+    for (auto& frame : m_frames)
+    {
+        frame.worker_pools.resize(m_worker_count + 1);
+        for (auto& worker_pool : frame.worker_pools)
+        {
+            auto pool_info = command_pool_create_info(m_graphics_queue.family_index);
+            worker_pool.pool =
+                std::make_unique<vk::raii::CommandPool>(*m_device, pool_info);
+
+            auto info = command_buffer_allocate_info(*worker_pool.pool,
+                                                     1,
+                                                     vk::CommandBufferLevel::eSecondary);
+            worker_pool.command_buffers = vk::raii::CommandBuffers{*m_device, info};
+        }
+    }
+}
+
+void VulkanEngine::init_profiler()
+{
+    m_profiler.init(*m_device,
+                    m_chosen_gpu,
+                    m_graphics_queue.family_index,
+                    m_frames_in_flight);
 }
 
 void VulkanEngine::init_default_render_pass()
@@ -375,7 +1591,8 @@ void VulkanEngine::init_default_render_pass()
         .stencilLoadOp  = vk::AttachmentLoadOp::eDontCare,
         .stencilStoreOp = vk::AttachmentStoreOp::eDontCare,
         .initialLayout  = vk::ImageLayout::eUndefined,
-        .finalLayout    = vk::ImageLayout::ePresentSrcKHR};
+        .finalLayout    = m_headless ? vk::ImageLayout::eTransferSrcOptimal
+                                     : vk::ImageLayout::ePresentSrcKHR};
 
     vk::AttachmentReference colour_attachment_ref{
         .attachment = 0,
@@ -418,8 +1635,22 @@ void VulkanEngine::init_default_render_pass()
         .srcAccessMask = vk::AccessFlagBits::eNone,
         .dstAccessMask = vk::AccessFlagBits::eDepthStencilAttachmentWrite};
 
-    std::array attachments  = {colour_attachment, depth_attachment};
-    std::array dependencies = {colour_dependency, depth_dependency};
+    // Offscreen images may be copied out after the pass, so make sure the colour writes
+    // (and the transition to TransferSrcOptimal) are done before that happens.
+    vk::SubpassDependency readback_dependency{
+        .srcSubpass    = 0,
+        .dstSubpass    = VK_SUBPASS_EXTERNAL,
+        .srcStageMask  = vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        .dstStageMask  = vk::PipelineStageFlagBits::eTransfer,
+        .srcAccessMask = vk::AccessFlagBits::eColorAttachmentWrite,
+        .dstAccessMask = vk::AccessFlagBits::eTransferRead};
+
+    std::array attachments = {colour_attachment, depth_attachment};
+    std::vector dependencies{colour_dependency, depth_dependency};
+    if (m_headless)
+    {
+        dependencies.push_back(readback_dependency);
+    }
 
     vk::RenderPassCreateInfo render_pass_info{
         .attachmentCount = static_cast<std::uint32_t>(attachments.size()),
@@ -456,13 +1687,65 @@ void VulkanEngine::init_framebuffers()
 
 void VulkanEngine::init_sync_structures()
 {
-    vk::FenceCreateInfo fence_create_info{.flags = vk::FenceCreateFlagBits::eSignaled};
-    m_render_fence = std::make_unique<vk::raii::Fence>(*m_device, fence_create_info);
+    // Frames start out with a timeline value of 0, which is always reached, so the
+    // first wait on each of them returns immediately.
+    m_graphics_queue.timeline.init(*m_device, m_graphics_queue.queue);
+    m_deletion_queue.push_function([this]() {
+        m_graphics_queue.timeline.destroy();
+    });
+
+    if (m_transfer_queue)
+    {
+        m_transfer_queue->timeline.init(*m_device, m_transfer_queue->queue);
+        m_deletion_queue.push_function([this]() {
+            m_transfer_queue->timeline.destroy();
+        });
+    }
 
     vk::SemaphoreCreateInfo semaphore_info;
-    m_present_semaphore =
-        std::make_unique<vk::raii::Semaphore>(*m_device, semaphore_info);
-    m_render_semaphore = std::make_unique<vk::raii::Semaphore>(*m_device, semaphore_info);
+    for (auto& frame : m_frames)
+    {
+        frame.present_semaphore =
+            std::make_unique<vk::raii::Semaphore>(*m_device, semaphore_info);
+        frame.render_semaphore =
+            std::make_unique<vk::raii::Semaphore>(*m_device, semaphore_info);
+    }
+}
+
+void VulkanEngine::init_upload_context()
+{
+    // Everything that's uploaded ends up being used by the graphics queue, so that's
+    // who ownership goes to.
+    auto& queue = get_upload_queue();
+    m_upload_context.init(*m_device,
+                          m_allocator,
+                          queue.timeline,
+                          queue.family_index,
+                          m_graphics_queue.family_index,
+                          staging_buffer_size);
+
+    m_deletion_queue.push_function([this]() {
+        m_upload_context.destroy();
+    });
+}
+
+void VulkanEngine::init_readback_buffer()
+{
+    vk::DeviceSize size = static_cast<vk::DeviceSize>(m_window_extent.width)
+                          * m_window_extent.height * 4;
+
+    m_readback_buffer = vk_types::create_buffer(m_allocator,
+                                                size,
+                                                vk::BufferUsageFlagBits::eTransferDst,
+                                                VMA_MEMORY_USAGE_GPU_TO_CPU,
+                                                VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+    m_resource_queue.push(m_readback_buffer, DeletionQueue::at_shutdown);
+}
+
+void VulkanEngine::init_thread_pool()
+{
+    m_thread_pool = std::make_unique<ThreadPool>(m_worker_count);
 }
 
 void VulkanEngine::init_pipelines()
@@ -474,7 +1757,9 @@ void VulkanEngine::init_pipelines()
     auto vert_module = load_shader_module(shader_root / "triangle.vert.spv");
     auto frag_module = load_shader_module(shader_root / "triangle.frag.spv");
 
-    auto pipeline_layout_info = pipeline_layout_create_info();
+    std::array set_layouts = {to_vk_type(m_global_set_layout),
+                              to_vk_type(m_object_set_layout),
+                              m_textures.get_set_layout()};
 
     vk::PushConstantRange push_constants{
         .stageFlags = vk::ShaderStageFlagBits::eVertex,
@@ -482,6 +1767,10 @@ void VulkanEngine::init_pipelines()
         .size       = sizeof(MeshPushConstants),
     };
 
+    auto pipeline_layout_info = pipeline_layout_create_info();
+    pipeline_layout_info.setLayoutCount =
+        static_cast<std::uint32_t>(set_layouts.size());
+    pipeline_layout_info.pSetLayouts            = set_layouts.data();
     pipeline_layout_info.pPushConstantRanges    = &push_constants;
     pipeline_layout_info.pushConstantRangeCount = 1;
 
@@ -513,16 +1802,6 @@ void VulkanEngine::init_pipelines()
     pipeline_builder.input_assembly =
         input_assembly_create_info(vk::PrimitiveTopology::eTriangleList);
 
-    pipeline_builder.viewport.x        = 0.0f;
-    pipeline_builder.viewport.y        = 0.0f;
-    pipeline_builder.viewport.width    = static_cast<float>(m_window_extent.width);
-    pipeline_builder.viewport.height   = static_cast<float>(m_window_extent.height);
-    pipeline_builder.viewport.minDepth = 0.0f;
-    pipeline_builder.viewport.maxDepth = 1.0f;
-
-    pipeline_builder.scissor.offset = vk::Offset2D{0, 0};
-    pipeline_builder.scissor.extent = m_window_extent;
-
     pipeline_builder.rasterizer = rasterization_create_info(vk::PolygonMode::eFill);
 
     pipeline_builder.multisampling           = multisampling_state_create_info();
@@ -531,8 +1810,298 @@ void VulkanEngine::init_pipelines()
         depth_stencil_create_info(true, true, vk::CompareOp::eLessOrEqual);
     pipeline_builder.pipeline_layout = to_vk_type(m_mesh_pipeline_layout);
 
-    m_mesh_pipeline = std::make_unique<vk::raii::Pipeline>(
-        pipeline_builder.build_pipeline(*m_device, to_vk_type(m_render_pass)));
+    m_mesh_pipelines = build_material_pipelines(pipeline_builder);
+
+    if (m_render_mode == RenderMode::eIndirect)
+    {
+        init_indirect_pipelines(pipeline_builder);
+    }
+    else if (m_render_mode == RenderMode::eInstanced)
+    {
+        init_instanced_pipeline(pipeline_builder);
+    }
+}
+
+void VulkanEngine::init_indirect_pipelines(PipelineBuilder& builder)
+{
+    namespace fs = std::filesystem;
+    using namespace vk_initialisers;
+
+    auto& indirect   = m_indirect;
+    auto set_layout  = to_vk_type(indirect.set_layout);
+    auto shader_root = fs::current_path() / "spv";
+
+    // The draw pipeline is the same as the mesh pipeline apart from the vertex shader,
+    // which takes the object index from gl_InstanceIndex instead of a push constant.
+    {
+        auto vert_module = load_shader_module(shader_root / "indirect.vert.spv");
+
+        std::array set_layouts = {to_vk_type(m_global_set_layout),
+                                  set_layout,
+                                  m_textures.get_set_layout()};
+
+        auto layout_info           = pipeline_layout_create_info();
+        layout_info.setLayoutCount = static_cast<std::uint32_t>(set_layouts.size());
+        layout_info.pSetLayouts    = set_layouts.data();
+
+        indirect.draw_pipeline_layout =
+            std::make_unique<vk::raii::PipelineLayout>(*m_device, layout_info);
+
+        builder.shader_stages[0] =
+            pipeline_shader_stage_create_info(vk::ShaderStageFlagBits::eVertex,
+                                              vert_module);
+        builder.pipeline_layout = to_vk_type(indirect.draw_pipeline_layout);
+
+        indirect.draw_pipeline = std::make_unique<vk::raii::Pipeline>(
+            builder.build_pipeline(*m_device,
+                                   *m_pipeline_cache,
+                                   to_vk_type(m_render_pass)));
+    }
+
+    {
+        auto cull_module = load_shader_module(shader_root / "cull.comp.spv");
+
+        vk::PushConstantRange push_constants{
+            .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            .offset     = 0,
+            .size       = sizeof(CullPushConstants),
+        };
+
+        auto layout_info                   = pipeline_layout_create_info();
+        layout_info.setLayoutCount         = 1;
+        layout_info.pSetLayouts            = &set_layout;
+        layout_info.pushConstantRangeCount = 1;
+        layout_info.pPushConstantRanges    = &push_constants;
+
+        indirect.cull_pipeline_layout =
+            std::make_unique<vk::raii::PipelineLayout>(*m_device, layout_info);
+
+        vk::ComputePipelineCreateInfo pipeline_info{
+            .stage = pipeline_shader_stage_create_info(vk::ShaderStageFlagBits::eCompute,
+                                                       cull_module),
+            .layout = to_vk_type(indirect.cull_pipeline_layout)};
+
+        indirect.cull_pipeline =
+            std::make_unique<vk::raii::Pipeline>(*m_device,
+                                                 *m_pipeline_cache,
+                                                 pipeline_info);
+    }
+}
+
+void VulkanEngine::init_instanced_pipeline(PipelineBuilder& builder)
+{
+    namespace fs = std::filesystem;
+    using namespace vk_initialisers;
+
+    auto& instanced  = m_instanced;
+    auto shader_root = fs::current_path() / "spv";
+
+    // Same as the mesh pipeline apart from the vertex shader, which reads the model
+    // matrix from the instance buffer.
+    auto vert_module = load_shader_module(shader_root / "instanced.vert.spv");
+
+    std::array set_layouts = {to_vk_type(m_global_set_layout),
+                              to_vk_type(instanced.set_layout),
+                              m_textures.get_set_layout()};
+
+    // Instances share one texture per draw, so it's pushed rather than stored per
+    // instance.
+    vk::PushConstantRange push_constants{
+        .stageFlags = vk::ShaderStageFlagBits::eVertex,
+        .offset     = 0,
+        .size       = sizeof(InstancedPushConstants),
+    };
+
+    auto layout_info                   = pipeline_layout_create_info();
+    layout_info.setLayoutCount         = static_cast<std::uint32_t>(set_layouts.size());
+    layout_info.pSetLayouts            = set_layouts.data();
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges    = &push_constants;
+
+    instanced.pipeline_layout =
+        std::make_unique<vk::raii::PipelineLayout>(*m_device, layout_info);
+
+    builder.shader_stages[0] =
+        pipeline_shader_stage_create_info(vk::ShaderStageFlagBits::eVertex, vert_module);
+    builder.pipeline_layout = to_vk_type(instanced.pipeline_layout);
+
+    instanced.pipelines = build_material_pipelines(builder);
+}
+
+std::array<std::unique_ptr<vk::raii::Pipeline>, material_pipeline_count>
+VulkanEngine::build_material_pipelines(PipelineBuilder& builder)
+{
+    namespace fs = std::filesystem;
+    using namespace vk_initialisers;
+
+    auto shader_root = fs::current_path() / "spv";
+
+    std::array<vk::raii::ShaderModule, material_pipeline_count> frag_modules{
+        load_shader_module(shader_root / "triangle.frag.spv"),
+        load_shader_module(shader_root / "colour.frag.spv")};
+
+    // The modules only live until the end of this function, so put back whatever
+    // fragment stage the builder came with once we're done.
+    auto frag_stage = builder.shader_stages[1];
+
+    std::array<std::unique_ptr<vk::raii::Pipeline>, material_pipeline_count> pipelines;
+    for (std::size_t i{0}; i < material_pipeline_count; ++i)
+    {
+        builder.shader_stages[1] =
+            pipeline_shader_stage_create_info(vk::ShaderStageFlagBits::eFragment,
+                                              frag_modules[i]);
+        pipelines[i] = std::make_unique<vk::raii::Pipeline>(
+            builder.build_pipeline(*m_device,
+                                   *m_pipeline_cache,
+                                   to_vk_type(m_render_pass)));
+    }
+
+    builder.shader_stages[1] = frag_stage;
+    return pipelines;
+}
+
+void VulkanEngine::init_descriptors()
+{
+    // Sized for what the engine needs in its largest configuration, though the allocator
+    // adds more pools if that ever stops being true.
+    std::vector<DescriptorAllocator::PoolRatio> ratios = {
+        {.type = vk::DescriptorType::eUniformBufferDynamic, .ratio = 1.0f},
+        {.type = vk::DescriptorType::eStorageBuffer,        .ratio = 4.0f},
+        // Each frame in flight gets its own copy of the whole texture array.
+        {.type = vk::DescriptorType::eCombinedImageSampler,
+         .ratio = static_cast<float>(TextureCache::max_textures) / 2.0f}
+    };
+    m_descriptor_allocator.init(*m_device, 8, std::move(ratios));
+
+    m_global_set_layout = std::make_unique<vk::raii::DescriptorSetLayout>(
+        DescriptorLayoutBuilder{}
+            .add_binding(SCENE_DATA_BINDING,
+                         vk::DescriptorType::eUniformBufferDynamic,
+                         vk::ShaderStageFlagBits::eVertex)
+            .build(*m_device));
+
+    m_object_set_layout = std::make_unique<vk::raii::DescriptorSetLayout>(
+        DescriptorLayoutBuilder{}
+            .add_binding(OBJECT_BUFFER_BINDING,
+                         vk::DescriptorType::eStorageBuffer,
+                         vk::ShaderStageFlagBits::eVertex)
+            .build(*m_device));
+
+    // Every slot has to start on an offset the device accepts for dynamic uniform
+    // buffers.
+    auto alignment = m_chosen_gpu.getProperties().limits.minUniformBufferOffsetAlignment;
+    m_scene_stride = (sizeof(GpuSceneData) + alignment - 1) & ~(alignment - 1);
+
+    m_scene_buffer = vk_types::create_buffer(m_allocator,
+                                             m_scene_stride * m_frames_in_flight,
+                                             vk::BufferUsageFlagBits::eUniformBuffer,
+                                             VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                             VMA_ALLOCATION_CREATE_MAPPED_BIT);
+    m_resource_queue.push(m_scene_buffer, DeletionQueue::at_shutdown);
+
+    m_global_set = m_descriptor_allocator.allocate(to_vk_type(m_global_set_layout));
+
+    // The range is a single slot, the dynamic offset picks which one.
+    vk::DescriptorBufferInfo buffer_info{.buffer = m_scene_buffer.buffer,
+                                         .offset = 0,
+                                         .range  = sizeof(GpuSceneData)};
+    vk::WriteDescriptorSet write{
+        .dstSet          = m_global_set,
+        .dstBinding      = SCENE_DATA_BINDING,
+        .dstArrayElement = 0,
+        .descriptorCount = 1,
+        .descriptorType  = vk::DescriptorType::eUniformBufferDynamic,
+        .pBufferInfo     = &buffer_info};
+    m_device->updateDescriptorSets({write}, {});
+
+    if (m_render_mode == RenderMode::eDirect)
+    {
+        m_object_set = m_descriptor_allocator.allocate(to_vk_type(m_object_set_layout));
+    }
+}
+
+void VulkanEngine::init_instanced_descriptors()
+{
+    auto& instanced = m_instanced;
+
+    instanced.set_layout = std::make_unique<vk::raii::DescriptorSetLayout>(
+        DescriptorLayoutBuilder{}
+            .add_binding(INSTANCE_BUFFER_BINDING,
+                         vk::DescriptorType::eStorageBuffer,
+                         vk::ShaderStageFlagBits::eVertex)
+            .build(*m_device));
+
+    for (std::uint32_t i{0}; i < m_frames_in_flight; ++i)
+    {
+        instanced.descriptor_sets.push_back(
+            m_descriptor_allocator.allocate(to_vk_type(instanced.set_layout)));
+    }
+}
+
+void VulkanEngine::init_textures()
+{
+    // Decoding is slow and can take a long time per image, so it gets its own threads
+    // rather than sharing the pool that records the frames.
+    m_textures.init(*m_device,
+                    m_chosen_gpu,
+                    m_allocator,
+                    m_upload_context,
+                    m_descriptor_allocator,
+                    m_frames_in_flight,
+                    std::max(m_worker_count / 2, 1u));
+
+    m_deletion_queue.push_function([this]() {
+        m_textures.destroy();
+    });
+}
+
+void VulkanEngine::init_indirect_descriptors()
+{
+    auto& indirect = m_indirect;
+
+    // The object buffer is read by both the culling pass and the vertex shader. The rest
+    // are only touched by the culling pass.
+    auto compute = vk::ShaderStageFlagBits::eCompute;
+    auto vertex  = vk::ShaderStageFlagBits::eVertex;
+    auto storage = vk::DescriptorType::eStorageBuffer;
+
+    indirect.set_layout = std::make_unique<vk::raii::DescriptorSetLayout>(
+        DescriptorLayoutBuilder{}
+            .add_binding(OBJECT_BUFFER_BINDING, storage, compute | vertex)
+            .add_binding(MESH_BUFFER_BINDING, storage, compute)
+            .add_binding(DRAW_COMMAND_BINDING, storage, compute)
+            .add_binding(DRAW_COUNT_BINDING, storage, compute)
+            .build(*m_device));
+
+    indirect.descriptor_set =
+        m_descriptor_allocator.allocate(to_vk_type(indirect.set_layout));
+}
+
+VulkanEngine::FrameData& VulkanEngine::get_current_frame()
+{
+    return m_frames[m_frame_number % m_frames.size()];
+}
+
+std::uint32_t VulkanEngine::get_current_frame_slot() const
+{
+    return static_cast<std::uint32_t>(m_frame_number % m_frames.size());
+}
+
+VulkanEngine::Queue& VulkanEngine::get_upload_queue()
+{
+    return m_transfer_queue ? *m_transfer_queue : m_graphics_queue;
+}
+
+std::uint64_t VulkanEngine::get_retire_value() const
+{
+    // Whatever gets submitted next (this frame or an upload) queues up behind the work
+    // that may still be using the resource, so its value covers it.
+    return m_graphics_queue.timeline.get_next_value();
+}
+
+std::uint64_t VulkanEngine::get_completed_value()
+{
+    return m_graphics_queue.timeline.get_completed_value();
 }
 
 vk::raii::ShaderModule VulkanEngine::load_shader_module(std::filesystem::path const& path)
@@ -562,102 +2131,328 @@ void VulkanEngine::load_meshes()
 {
     namespace fs = std::filesystem;
 
-    auto model_root = fs::current_path() / "models";
+    auto model_path = m_model_path;
+    if (model_path.empty())
+    {
+        model_path = fs::current_path() / "models" / "monkey_smooth.obj";
+    }
+
+    m_model.load_from_file(model_path, m_thread_pool.get(), m_optimise_meshes);
 
-    m_model.load_from_file(model_root / "monkey_smooth.obj");
+    // Mesh and material indices go into the scene's sort keys, which only have room for
+    // so many of each. Better to say so now than to draw in the wrong order later.
+    std::size_t max_count = Scene::max_sort_value + 1;
+    if (m_model.meshes.size() > max_count || m_model.materials.size() > max_count)
+    {
+        auto msg = fmt::format("error: {} has {} meshes and {} materials, but at most {} "
+                               "of each are supported",
+                               model_path.string(),
+                               m_model.meshes.size(),
+                               m_model.materials.size(),
+                               max_count);
+        throw std::runtime_error{msg.c_str()};
+    }
+
+    auto geometry_size =
+        m_model.get_vertices().size_bytes() + m_model.get_indices().size_bytes();
+    upload_model(m_model);
 
-    for (auto& mesh : m_model.meshes)
+    // The upload copies everything into the staging ring straight away, so the CPU copy
+    // can go before the batch has even been submitted.
+    if (m_release_geometry)
     {
-        upload_mesh(mesh);
+        m_model.release_geometry();
+    }
+    process_memory::print_peak_rss("after loading the model", geometry_size);
+
+    // Only the slots are handed out here, the images themselves show up over the next
+    // few frames. Until then the materials just use the default texture. Materials
+    // without a diffuse map skip the texture altogether.
+    m_materials.clear();
+    m_materials.reserve(m_model.materials.size());
+    for (auto const& info : m_model.materials)
+    {
+        Material material;
+        if (!info.diffuse_texture.empty())
+        {
+            material.pipeline = MaterialPipeline::eTextured;
+            material.texture =
+                m_textures.request(model_path.parent_path() / info.diffuse_texture);
+        }
+
+        m_materials.push_back(material);
     }
 }
 
-template<typename T>
-void copy_data(VmaAllocator allocator,
-               VmaAllocation allocation,
-               std::vector<T> const& buffer)
+void VulkanEngine::init_scene()
 {
-    void* data{nullptr};
-    vmaMapMemory(allocator, allocation, &data);
-    std::memcpy(data, buffer.data(), buffer.size() * sizeof(T));
-    vmaUnmapMemory(allocator, allocation);
+    // Space the instances out far enough that their bounding spheres never overlap.
+    float model_radius{0.0f};
+    for (auto const& mesh : m_model.meshes)
+    {
+        auto const& sphere = mesh.bounding_sphere;
+        model_radius = std::max(model_radius, glm::length(glm::vec3{sphere}) + sphere.w);
+    }
+
+    float spacing = model_radius * 2.5f;
+    auto side         = static_cast<std::uint32_t>(
+        std::ceil(std::sqrt(static_cast<float>(m_object_count))));
+    float half_extent = (side - 1) * spacing * 0.5f;
+
+    m_scene.clear();
+    m_scene.reserve(m_object_count * (m_model.meshes.size() + 1));
+    for (std::uint32_t i{0}; i < m_object_count; ++i)
+    {
+        glm::vec3 position{(i % side) * spacing - half_extent,
+                           0.0f,
+                           (i / side) * spacing - half_extent};
+        auto instance = m_scene.add_object({.position = position});
+
+        for (std::uint32_t mesh{0}; mesh < m_model.meshes.size(); ++mesh)
+        {
+            auto material = m_model.meshes[mesh].material_index;
+            auto pipeline = static_cast<std::uint32_t>(m_materials[material].pipeline);
+            m_scene.add_object({.parent   = instance,
+                                .mesh     = mesh,
+                                .pipeline = pipeline,
+                                .material = material});
+        }
+    }
+
+    m_scene_extent = half_extent;
+
+    // Everything starts out dirty, so this is the worst case for both.
+    using Clock = std::chrono::steady_clock;
+    auto start  = Clock::now();
+    m_scene.update();
+    auto updated = Clock::now();
+    m_scene.sort();
+    auto sorted = Clock::now();
+
+    fmt::print("scene: {} objects, update {:.3f} ms, sort {:.3f} ms\n",
+               m_scene.size(),
+               std::chrono::duration<double, std::milli>(updated - start).count(),
+               std::chrono::duration<double, std::milli>(sorted - updated).count());
+
+    update_cull_spheres();
 }
 
-template<typename T>
-struct CreateBufferParams
+void VulkanEngine::update_cull_spheres()
 {
-    std::vector<T>& buffer_data;
-    VmaAllocator& allocator;
-    vk::BufferCreateInfo buffer_info;
-    VmaAllocationCreateInfo alloc_info;
-    vk::Buffer& buffer;
-    VmaAllocation& allocation;
-};
+    m_cull_spheres.clear();
+    if (m_render_mode == RenderMode::eIndirect)
+    {
+        return;
+    }
+
+    auto draw_order = m_scene.get_draw_order();
+    m_cull_spheres.reserve(draw_order.size());
+    for (auto object : draw_order)
+    {
+        auto const& mesh = m_model.meshes[m_scene.get_mesh(object)];
+        m_cull_spheres.push_back(
+            culling::transform_sphere(m_scene.get_world_transform(object),
+                                      mesh.bounding_sphere));
+    }
+}
 
-template<typename T>
-void create_buffer(CreateBufferParams<T>& params)
+void VulkanEngine::init_object_buffer()
 {
-    auto& [buffer_data, allocator, buffer_info, alloc_info, buffer, allocation] = params;
-    if (vmaCreateBuffer(allocator,
-                        to_vkc_ptr(&buffer_info),
-                        &alloc_info,
-                        to_vkc_ptr(&buffer),
-                        &allocation,
-                        nullptr)
-        != VK_SUCCESS)
+    // One object for every drawable object in the scene.
+    std::vector<GpuObjectData> objects(m_scene.get_draw_order().size());
+    write_object_data(objects);
+
+    std::span<GpuObjectData const> object_data{objects};
+    m_object_buffer =
+        vk_types::create_buffer(m_allocator,
+                                object_data.size_bytes(),
+                                vk::BufferUsageFlagBits::eStorageBuffer
+                                    | vk::BufferUsageFlagBits::eTransferDst,
+                                VMA_MEMORY_USAGE_GPU_ONLY);
+    m_resource_queue.push(m_object_buffer, DeletionQueue::at_shutdown);
+    m_upload_context.upload(m_object_buffer.buffer, 0, object_data);
+
+    // Later changes to the scene are copied over from one of these, so the frame never
+    // writes to memory an earlier frame may still be copying from.
+    for (std::uint32_t i{0}; i < m_frames_in_flight; ++i)
     {
-        ASSERT(0);
+        auto buffer = vk_types::create_buffer(m_allocator,
+                                              object_data.size_bytes(),
+                                              vk::BufferUsageFlagBits::eTransferSrc,
+                                              VMA_MEMORY_USAGE_CPU_ONLY,
+                                              VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+        m_resource_queue.push(buffer, DeletionQueue::at_shutdown);
+        m_object_staging_buffers.push_back(buffer);
     }
 
-    copy_data(allocator, allocation, buffer_data);
+    if (m_object_set)
+    {
+        vk::DescriptorBufferInfo buffer_info{.buffer = m_object_buffer.buffer,
+                                             .offset = 0,
+                                             .range  = VK_WHOLE_SIZE};
+        vk::WriteDescriptorSet write{
+            .dstSet          = m_object_set,
+            .dstBinding      = OBJECT_BUFFER_BINDING,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo     = &buffer_info};
+        m_device->updateDescriptorSets({write}, {});
+    }
 }
 
-void VulkanEngine::upload_mesh(Mesh& mesh)
+void VulkanEngine::write_object_data(std::span<GpuObjectData> objects) const
 {
-    VmaAllocationCreateInfo alloc_info = {};
-    alloc_info.usage                   = VMA_MEMORY_USAGE_CPU_TO_GPU;
-
-    // Vertex buffer goes first.
-    {
-        CreateBufferParams<Vertex> params{
-            .buffer_data = mesh.vertices,
-            .allocator   = m_allocator,
-            .buffer_info =
-                vk::BufferCreateInfo{.size  = mesh.vertices.size() * sizeof(Vertex),
-                                     .usage = vk::BufferUsageFlagBits::eVertexBuffer},
-            .alloc_info = alloc_info,
-            .buffer     = mesh.vertex_buffer.buffer,
-            .allocation = mesh.vertex_buffer.allocation
-        };
+    auto draw_order = m_scene.get_draw_order();
+    ASSERT(objects.size() == draw_order.size());
 
-        create_buffer(params);
+    for (std::size_t i{0}; i < draw_order.size(); ++i)
+    {
+        auto object   = draw_order[i];
+        auto material = m_materials[m_scene.get_material(object)];
+        objects[i]    = GpuObjectData{
+            .model         = m_scene.get_world_transform(object),
+            .mesh_index    = m_scene.get_mesh(object),
+            .texture_index = material.texture};
+    }
+}
 
-        m_deletion_queue.push_function([this, mesh]() {
-            vmaDestroyBuffer(m_allocator,
-                             mesh.vertex_buffer.buffer,
-                             mesh.vertex_buffer.allocation);
-        });
+void VulkanEngine::init_indirect_buffers()
+{
+    auto& indirect = m_indirect;
+
+    std::vector<GpuMeshData> meshes;
+    meshes.reserve(m_model.meshes.size());
+    for (auto const& mesh : m_model.meshes)
+    {
+        meshes.push_back(GpuMeshData{.index_count     = mesh.index_count,
+                                     .first_index     = mesh.first_index,
+                                     .vertex_offset   = mesh.vertex_offset,
+                                     .bounding_sphere = mesh.bounding_sphere});
     }
 
-    // Now the index buffer.
+    indirect.object_count = static_cast<std::uint32_t>(m_scene.get_draw_order().size());
+
+    auto create_buffer = [this](vk::DeviceSize size, vk::BufferUsageFlags usage) {
+        usage |= vk::BufferUsageFlagBits::eStorageBuffer;
+        auto buffer = vk_types::create_buffer(m_allocator,
+                                              size,
+                                              usage,
+                                              VMA_MEMORY_USAGE_GPU_ONLY);
+
+        m_resource_queue.push(buffer, DeletionQueue::at_shutdown);
+
+        return buffer;
+    };
+
+    std::span<GpuMeshData const> mesh_data{meshes};
+
+    indirect.mesh_buffer =
+        create_buffer(mesh_data.size_bytes(), vk::BufferUsageFlagBits::eTransferDst);
+    m_upload_context.upload(indirect.mesh_buffer.buffer, 0, mesh_data);
+
+    indirect.command_buffer =
+        create_buffer(indirect.object_count * sizeof(vk::DrawIndexedIndirectCommand),
+                      vk::BufferUsageFlagBits::eIndirectBuffer);
+
+    indirect.count_buffer =
+        create_buffer(sizeof(std::uint32_t),
+                      vk::BufferUsageFlagBits::eIndirectBuffer
+                          | vk::BufferUsageFlagBits::eTransferDst);
+
+    std::array buffer_infos = {
+        vk::DescriptorBufferInfo{.buffer = m_object_buffer.buffer,
+                                 .offset = 0,
+                                 .range  = VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{.buffer = indirect.mesh_buffer.buffer,
+                                 .offset = 0,
+                                 .range  = VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{.buffer = indirect.command_buffer.buffer,
+                                 .offset = 0,
+                                 .range  = VK_WHOLE_SIZE},
+        vk::DescriptorBufferInfo{.buffer = indirect.count_buffer.buffer,
+                                 .offset = 0,
+                                 .range  = VK_WHOLE_SIZE}
+    };
+
+    std::array<std::uint32_t, 4> bindings = {OBJECT_BUFFER_BINDING,
+                                             MESH_BUFFER_BINDING,
+                                             DRAW_COMMAND_BINDING,
+                                             DRAW_COUNT_BINDING};
+
+    std::array<vk::WriteDescriptorSet, 4> writes;
+    for (std::size_t i{0}; i < writes.size(); ++i)
     {
-        CreateBufferParams<std::uint32_t> params{
-            .buffer_data = mesh.indices,
-            .allocator   = m_allocator,
-            .buffer_info =
-                vk::BufferCreateInfo{.size  = mesh.indices.size() * sizeof(std::uint32_t),
-                                     .usage = vk::BufferUsageFlagBits::eIndexBuffer},
-            .alloc_info = alloc_info,
-            .buffer     = mesh.index_buffer.buffer,
-            .allocation = mesh.index_buffer.allocation
-        };
+        writes[i] = vk::WriteDescriptorSet{.dstSet          = indirect.descriptor_set,
+                                           .dstBinding      = bindings[i],
+                                           .dstArrayElement = 0,
+                                           .descriptorCount = 1,
+                                           .descriptorType =
+                                               vk::DescriptorType::eStorageBuffer,
+                                           .pBufferInfo = &buffer_infos[i]};
+    }
 
-        create_buffer(params);
+    m_device->updateDescriptorSets(writes, {});
+}
 
-        m_deletion_queue.push_function([this, mesh]() {
-            vmaDestroyBuffer(m_allocator,
-                             mesh.index_buffer.buffer,
-                             mesh.index_buffer.allocation);
-        });
+void VulkanEngine::init_instance_buffers()
+{
+    auto& instanced = m_instanced;
+
+    // These are rewritten every frame straight from the CPU, so there's no point in
+    // going through the staging ring.
+    vk::DeviceSize size = m_scene.get_draw_order().size() * sizeof(glm::mat4);
+    for (std::uint32_t i{0}; i < m_frames_in_flight; ++i)
+    {
+        auto buffer = vk_types::create_buffer(m_allocator,
+                                              size,
+                                              vk::BufferUsageFlagBits::eStorageBuffer,
+                                              VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                              VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+        m_resource_queue.push(buffer, DeletionQueue::at_shutdown);
+
+        vk::DescriptorBufferInfo buffer_info{.buffer = buffer.buffer,
+                                             .offset = 0,
+                                             .range  = VK_WHOLE_SIZE};
+        vk::WriteDescriptorSet write{
+            .dstSet          = instanced.descriptor_sets[i],
+            .dstBinding      = INSTANCE_BUFFER_BINDING,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType  = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo     = &buffer_info};
+        m_device->updateDescriptorSets({write}, {});
+
+        instanced.instance_buffers.push_back(buffer);
     }
 }
+
+void VulkanEngine::upload_model(Model& model)
+{
+    // Geometry lives in device-local memory. The data itself goes through the staging
+    // ring, so nothing here maps or touches these buffers from the host.
+    auto create_buffer = [this](vk::DeviceSize size, vk::BufferUsageFlags usage) {
+        auto buffer = vk_types::create_buffer(m_allocator,
+                                              size,
+                                              usage
+                                                  | vk::BufferUsageFlagBits::eTransferDst,
+                                              VMA_MEMORY_USAGE_GPU_ONLY);
+
+        m_resource_queue.push(buffer, DeletionQueue::at_shutdown);
+
+        return buffer;
+    };
+
+    auto vertices = model.get_vertices();
+    auto indices  = model.get_indices();
+
+    model.vertex_buffer =
+        create_buffer(vertices.size_bytes(), vk::BufferUsageFlagBits::eVertexBuffer);
+    m_upload_context.upload(model.vertex_buffer.buffer, 0, vertices);
+
+    model.index_buffer =
+        create_buffer(indices.size_bytes(), vk::BufferUsageFlagBits::eIndexBuffer);
+    m_upload_context.upload(model.index_buffer.buffer, 0, indices);
+}
@@ -1,19 +1,73 @@
 #pragma once
 
+#include "linear_arena.hpp"
+#include "vk_culling.hpp"
+#include "vk_deletion_queue.hpp"
+#include "vk_descriptors.hpp"
 #include "vk_mesh.hpp"
+#include "vk_profiler.hpp"
+#include "vk_scene.hpp"
+#include "vk_textures.hpp"
+#include "vk_timeline.hpp"
+#include "vk_upload.hpp"
 
 using SurfaceCallback = std::function<VkSurfaceKHR(vk::Instance const&)>;
 
+enum class RenderMode
+{
+    // One push constant and draw per instance, recorded by the CPU.
+    eDirect,
+    // Culling and draw generation happen in a compute pass and everything is drawn
+    // through a single drawIndexedIndirectCount.
+    eIndirect,
+    // The transforms are written to a buffer once per frame and each mesh is drawn once
+    // for every instance with a single drawIndexed.
+    eInstanced
+};
+
+// The pipelines a material can be drawn with. Draws are sorted by pipeline first, so this
+// is also the order they're drawn in.
+enum class MaterialPipeline : std::uint32_t
+{
+    // Multiplies the vertex colour with the material's diffuse map.
+    eTextured,
+    // Vertex colour only, for materials without a diffuse map.
+    eVertexColour,
+    eCount
+};
+
+inline constexpr std::size_t material_pipeline_count{
+    static_cast<std::size_t>(MaterialPipeline::eCount)};
+
+// What a frame's draws cost in state changes. Binds are only recorded when the state
+// actually changes, so these show how well the draws are batched.
+struct DrawStats
+{
+    DrawStats& operator+=(DrawStats const& other)
+    {
+        pipeline_binds += other.pipeline_binds;
+        descriptor_binds += other.descriptor_binds;
+        draws += other.draws;
+        return *this;
+    }
+
+    std::uint32_t pipeline_binds{0};
+    std::uint32_t descriptor_binds{0};
+    std::uint32_t draws{0};
+};
+
+// Viewport and scissor are always dynamic state, so pipelines don't depend on the size of
+// the swapchain and survive it being recreated. They have to be set on every command
+// buffer that draws with them.
 struct PipelineBuilder
 {
     vk::raii::Pipeline build_pipeline(vk::raii::Device const& device,
+                                      vk::raii::PipelineCache const& cache,
                                       vk::RenderPass pass);
 
     std::vector<vk::PipelineShaderStageCreateInfo> shader_stages;
     vk::PipelineVertexInputStateCreateInfo vertex_input_info;
     vk::PipelineInputAssemblyStateCreateInfo input_assembly;
-    vk::Viewport viewport;
-    vk::Rect2D scissor;
     vk::PipelineRasterizationStateCreateInfo rasterizer;
     vk::PipelineColorBlendAttachmentState colour_blend_attachment;
     vk::PipelineMultisampleStateCreateInfo multisampling;
@@ -26,7 +80,7 @@ struct MemoryDeletionQueue
 
     void push_function(std::function<void()>&& function)
     {
-        deleters.push_back(function);
+        deleters.push_back(std::move(function));
     }
 
     void flush()
@@ -41,19 +95,115 @@ struct MemoryDeletionQueue
     std::deque<std::function<void()>> deleters;
 };
 
+struct FrameTimer
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Records the time elapsed since the previous call and periodically prints the
+    // average frame time, draw stats and heap allocations over the last reporting
+    // interval. Allocations are only reported if they're being counted.
+    void tick(DrawStats const& stats, std::uint64_t allocations);
+
+    Clock::time_point last_frame{};
+    Clock::time_point last_report{};
+    double accumulated_ms{0.0};
+    DrawStats accumulated_stats{};
+    std::uint64_t accumulated_allocations{0};
+    std::uint32_t frame_count{0};
+    std::chrono::milliseconds report_interval{1000};
+};
+
+// Delays the start of each frame so that it finishes as close as possible to when it's
+// needed instead of as early as possible. Anything sampled at the start of the frame
+// (input in particular) is that much fresher by the time it reaches the screen. The
+// frame interval and the time spent actually working on a frame are both tracked as
+// moving averages, so the pacer adapts to the display and to the load.
+struct FramePacer
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Sleeps until the predicted start of the next frame, if that's still ahead.
+    void wait();
+
+    // Call once the frame has been handed off. Time spent blocked on the GPU or the
+    // swapchain is excluded from the work estimate, since pacing removes it.
+    void end_frame(Clock::duration blocked);
+
+    Clock::time_point frame_start{};
+    Clock::time_point last_end{};
+    double interval_ms{0.0};
+    double work_ms{0.0};
+    double smoothing{0.1};
+    double safety_margin_ms{1.0};
+};
+
 class VulkanEngine
 {
 public:
+    static constexpr vk::DeviceSize staging_buffer_size{64 * 1024 * 1024};
+
+    // Parallel recording won't split the objects into tasks smaller than this, since
+    // below it the cost of handing the work out outweighs the recording itself.
+    static constexpr std::size_t min_objects_per_task{64};
+
+    // Starting size of each frame's arena. It grows if a frame ever needs more, so this
+    // only has to be a good guess.
+    static constexpr std::size_t frame_arena_size{1024 * 1024};
+
     VulkanEngine() = default;
     ~VulkanEngine();
 
     void set_surface_callback(SurfaceCallback&& callback);
     void set_window_extent(vk::Extent2D extent);
+    void set_frames_in_flight(std::uint32_t count);
+    void set_render_mode(RenderMode mode);
+    void set_object_count(std::uint32_t count);
+    void set_worker_count(std::uint32_t count);
+    void set_optimise_meshes(bool optimise);
+
+    // Model to load instead of the default monkey. Any diffuse maps its materials
+    // reference are looked up relative to it and streamed in after startup.
+    void set_model_path(std::filesystem::path const& path);
+
+    // Frees the CPU copy of the model's geometry once it has been uploaded. Nothing
+    // after the upload reads it, so this only trades away being able to re-upload it.
+    void set_release_geometry(bool release);
+
+    // Splits the direct draws across the thread pool, each task recording into its own
+    // secondary command buffer. Has no effect in indirect mode, which only records one
+    // draw.
+    void set_parallel_recording(bool parallel);
+
+    // Falls back to FIFO, which is always supported, if the mode isn't available.
+    void set_present_mode(vk::PresentModeKHR mode);
+    // Minimum number of swapchain images to ask for, 0 leaves it up to vk-bootstrap.
+    void set_swapchain_image_count(std::uint32_t count);
+    void set_frame_pacing(bool pacing);
+
+    // Renders into offscreen images instead of a swapchain, so no surface (and therefore
+    // no window) is needed. The surface callback is ignored in this mode.
+    void set_headless(bool headless);
+
+    // If set, the profiler's events are written to path as a Chrome trace on shutdown.
+    void set_trace_path(std::filesystem::path const& path);
 
     void init();
 
+    // Blocks until the frame pacer thinks the next frame should start. Anything that
+    // should be as fresh as possible (e.g. polling input) should happen right after.
+    // Returns immediately if pacing is disabled.
+    void wait_for_next_frame();
+
     void render();
 
+    // Reads back the next frame that is rendered and writes it to path as a PPM. Only
+    // supported in headless mode.
+    void request_capture(std::filesystem::path const& path);
+
+    // Called when the window's framebuffer changes size. The swapchain is rebuilt at the
+    // start of the next frame, and rendering is skipped while either side is 0.
+    void resize(vk::Extent2D extent);
+
 private:
     struct Swapchain
     {
@@ -64,6 +214,10 @@ private:
         std::vector<vk::Image> images;
         std::vector<UniqueImageView> image_views;
 
+        // In headless mode there is no handle and the images above are allocated by us
+        // instead, one per frame in flight.
+        std::vector<vk_types::AllocatedImage> offscreen_images;
+
         vk::Format depth_format;
         vk_types::AllocatedImage depth_image;
         UniqueImageView depth_image_view;
@@ -76,6 +230,9 @@ private:
         // of the RAII namespace.
         vk::Queue queue;
         std::uint32_t family_index{0};
+
+        // Every submission to the queue signals this, frames and uploads alike.
+        QueueTimeline timeline;
     };
 
     struct CommandPool
@@ -84,22 +241,159 @@ private:
         vk::raii::CommandBuffers command_buffers{nullptr};
     };
 
+    struct FrameData
+    {
+        CommandPool command_pool;
+
+        // Binary, since that's all the swapchain understands.
+        std::unique_ptr<vk::raii::Semaphore> present_semaphore;
+        std::unique_ptr<vk::raii::Semaphore> render_semaphore;
+
+        // The graphics timeline value the frame last signaled, 0 if it hasn't been
+        // submitted yet.
+        std::uint64_t timeline_value{0};
+
+        // One pool with a single secondary command buffer per recording task. Every task
+        // gets its own pool, so no two threads ever touch the same one.
+        std::vector<CommandPool> worker_pools;
+
+        // Everything the CPU only needs while building the frame (visible lists, per-task
+        // results, descriptor writes). Reset once the frame has been waited on.
+        std::unique_ptr<LinearArena> arena;
+    };
+
+    struct IndirectDraw
+    {
+        std::unique_ptr<vk::raii::DescriptorSetLayout> set_layout;
+        vk::DescriptorSet descriptor_set;
+
+        std::unique_ptr<vk::raii::PipelineLayout> cull_pipeline_layout;
+        std::unique_ptr<vk::raii::Pipeline> cull_pipeline;
+        std::unique_ptr<vk::raii::PipelineLayout> draw_pipeline_layout;
+        std::unique_ptr<vk::raii::Pipeline> draw_pipeline;
+
+        vk_types::AllocatedBuffer mesh_buffer;
+        vk_types::AllocatedBuffer command_buffer;
+        vk_types::AllocatedBuffer count_buffer;
+        std::uint32_t object_count{0};
+    };
+
+    struct InstancedDraw
+    {
+        std::unique_ptr<vk::raii::DescriptorSetLayout> set_layout;
+
+        std::unique_ptr<vk::raii::PipelineLayout> pipeline_layout;
+        std::array<std::unique_ptr<vk::raii::Pipeline>, material_pipeline_count>
+            pipelines;
+
+        // One host-visible buffer of transforms (and a set pointing at it) per frame in
+        // flight, so we never write to one the GPU may still be reading.
+        std::vector<vk::DescriptorSet> descriptor_sets;
+        std::vector<vk_types::AllocatedBuffer> instance_buffers;
+    };
+
     void init_vulkan();
-    void init_swapchain();
+    void init_pipeline_cache();
+    void init_swapchain(vk::SwapchainKHR old_swapchain = {});
+    void init_offscreen_images();
+    void init_depth_image();
+    void create_depth_image();
+    void recreate_swapchain();
     void init_commands();
+    void init_profiler();
     void init_default_render_pass();
     void init_framebuffers();
     void init_sync_structures();
+    void init_upload_context();
+    void init_readback_buffer();
+    void init_thread_pool();
+    void init_descriptors();
+    void init_indirect_descriptors();
     void init_pipelines();
+    void init_indirect_pipelines(PipelineBuilder& builder);
+    void init_instanced_descriptors();
+    void init_instanced_pipeline(PipelineBuilder& builder);
+    void init_textures();
+
+    // Builds one pipeline per MaterialPipeline, swapping out the fragment stage of
+    // builder. Everything else, including the layout, has to be set already.
+    std::array<std::unique_ptr<vk::raii::Pipeline>, material_pipeline_count>
+    build_material_pipelines(PipelineBuilder& builder);
 
     void load_meshes();
-    void upload_mesh(Mesh& mesh);
+    void upload_model(Model& model);
+    void init_scene();
+    void update_cull_spheres();
+    void init_object_buffer();
+    void write_object_data(std::span<GpuObjectData> objects) const;
+    void init_indirect_buffers();
+    void init_instance_buffers();
+
+    void record_cull_pass(vk::raii::CommandBuffer const& cmd,
+                          glm::mat4 const& view_proj);
+    void cull_objects(glm::mat4 const& view_proj,
+                      std::pmr::vector<std::uint32_t>& visible);
+
+    // Copies the scene's current objects into the object buffer, ahead of any draws
+    // recorded into cmd.
+    void update_object_buffer(std::uint32_t slot, vk::raii::CommandBuffer const& cmd);
+
+    // Writes this frame's slot of the scene buffer and returns its dynamic offset.
+    std::uint32_t update_scene_data(std::uint32_t slot, GpuSceneData const& data);
+
+    void bind_descriptor_sets(vk::raii::CommandBuffer const& cmd,
+                              vk::PipelineLayout layout,
+                              vk::DescriptorSet object_set,
+                              std::uint32_t scene_offset);
+    DrawStats draw_direct(vk::raii::CommandBuffer const& cmd,
+                          std::uint32_t scene_offset,
+                          std::span<std::uint32_t const> objects);
+    DrawStats record_direct_parallel(FrameData& frame,
+                                     vk::raii::CommandBuffer const& cmd,
+                                     vk::Framebuffer framebuffer,
+                                     std::uint32_t scene_offset,
+                                     std::span<std::uint32_t const> objects);
+    DrawStats draw_indirect(vk::raii::CommandBuffer const& cmd,
+                            std::uint32_t scene_offset);
+    void update_instances(std::uint32_t slot, std::span<std::uint32_t const> objects);
+    DrawStats draw_instanced(vk::raii::CommandBuffer const& cmd,
+                             std::uint32_t slot,
+                             std::uint32_t scene_offset,
+                             std::span<std::uint32_t const> objects);
+    void record_capture(vk::raii::CommandBuffer const& cmd, vk::Image image);
+    void write_capture(std::filesystem::path const& path);
 
     vk::raii::ShaderModule load_shader_module(std::filesystem::path const& path);
 
+    FrameData& get_current_frame();
+    std::uint32_t get_current_frame_slot() const;
+
+    // The transfer queue if there is one, the graphics queue otherwise.
+    Queue& get_upload_queue();
+
+    // Resources retired while recording the current frame are stamped with the first
+    // value, and are freed once the second has caught up with it. Both are values of
+    // the graphics timeline.
+    std::uint64_t get_retire_value() const;
+    std::uint64_t get_completed_value();
+
     int m_frame_number{0};
+    std::uint32_t m_frames_in_flight{2};
+    RenderMode m_render_mode{RenderMode::eDirect};
+    std::uint32_t m_object_count{1};
+    std::uint32_t m_worker_count{std::max(std::thread::hardware_concurrency(), 2u) - 1};
+    bool m_optimise_meshes{false};
+    std::filesystem::path m_model_path;
+    bool m_release_geometry{false};
+    bool m_parallel_recording{false};
+    vk::PresentModeKHR m_present_mode{vk::PresentModeKHR::eFifo};
+    std::uint32_t m_swapchain_image_count{0};
+    bool m_frame_pacing{false};
+    bool m_headless{false};
     SurfaceCallback m_surface_callback;
     vk::Extent2D m_window_extent;
+    vk::Extent2D m_pending_extent;
+    bool m_swapchain_dirty{false};
 
     std::unique_ptr<vk::raii::Context> m_context;
     std::unique_ptr<vk::raii::Instance> m_instance;
@@ -112,20 +406,95 @@ private:
 
     Swapchain m_swapchain;
     Queue m_graphics_queue;
-    CommandPool m_command_pool;
+
+    // Only set when the device has a transfer family of its own, so uploads can run
+    // alongside rendering. Otherwise (e.g. on lavapipe) they go through the graphics
+    // queue.
+    std::optional<Queue> m_transfer_queue;
 
     std::unique_ptr<vk::raii::RenderPass> m_render_pass;
 
     std::vector<vk::raii::Framebuffer> m_framebuffers;
 
-    std::unique_ptr<vk::raii::Semaphore> m_present_semaphore;
-    std::unique_ptr<vk::raii::Semaphore> m_render_semaphore;
-    std::unique_ptr<vk::raii::Fence> m_render_fence;
+    std::vector<FrameData> m_frames;
+    FrameTimer m_frame_timer;
+    FramePacer m_frame_pacer;
+
+    Profiler m_profiler;
+    std::optional<std::filesystem::path> m_trace_path;
+
+    // Shared by every pipeline we build, and persisted to disk between runs.
+    std::unique_ptr<vk::raii::PipelineCache> m_pipeline_cache;
 
+    // Every set comes out of here, and they all live as long as the engine does.
+    DescriptorAllocator m_descriptor_allocator;
+
+    // Set 0 of every graphics pipeline. It only holds the scene data, which has one slot
+    // per frame in flight in a persistently mapped buffer. The slot is picked with a
+    // dynamic offset, so the same set is bound every frame.
+    std::unique_ptr<vk::raii::DescriptorSetLayout> m_global_set_layout;
+    vk::DescriptorSet m_global_set;
+    vk_types::AllocatedBuffer m_scene_buffer;
+    vk::DeviceSize m_scene_stride{0};
+
+    // The model matrix and mesh of every object in the scene's draw order. Read by the
+    // direct draws through their own set, and by the indirect path through its set.
+    // Whenever the scene changes, the frame rewrites it from its own staging buffer.
+    vk_types::AllocatedBuffer m_object_buffer;
+    std::vector<vk_types::AllocatedBuffer> m_object_staging_buffers;
+    std::unique_ptr<vk::raii::DescriptorSetLayout> m_object_set_layout;
+    vk::DescriptorSet m_object_set;
+
+    // Every material pipeline shares the same layout, so the descriptor sets stay bound
+    // when switching between them.
     std::unique_ptr<vk::raii::PipelineLayout> m_mesh_pipeline_layout;
-    std::unique_ptr<vk::raii::Pipeline> m_mesh_pipeline;
+    std::array<std::unique_ptr<vk::raii::Pipeline>, material_pipeline_count>
+        m_mesh_pipelines;
 
+    IndirectDraw m_indirect;
+    InstancedDraw m_instanced;
+
+    // Tears down the engine's subsystems at shutdown, in reverse order of creation.
     MemoryDeletionQueue m_deletion_queue;
+    // Buffers, images and swapchain objects, either retired mid-frame or kept until
+    // shutdown.
+    DeletionQueue m_resource_queue;
     VmaAllocator m_allocator;
+
+    std::unique_ptr<ThreadPool> m_thread_pool;
+
+    UploadContext m_upload_context;
+    std::uint64_t m_scene_upload_value{0};
+
+    // Host-visible copy of the colour image, only allocated in headless mode.
+    vk_types::AllocatedBuffer m_readback_buffer;
+    std::optional<std::filesystem::path> m_capture_path;
+
     Model m_model;
+
+    // What each of the model's materials, in the order Assimp imported them, is drawn
+    // with. The texture is a slot in set 2 of every graphics pipeline.
+    struct Material
+    {
+        MaterialPipeline pipeline{MaterialPipeline::eVertexColour};
+        std::uint32_t texture{TextureCache::default_texture};
+    };
+
+    TextureCache m_textures;
+    std::vector<Material> m_materials;
+
+    // Instances of m_model laid out on a grid around the origin. Each instance is a node
+    // with one child per mesh.
+    Scene m_scene;
+    float m_scene_extent{0.0f};
+
+    // World-space bounds for the CPU culling, which is used by every mode except
+    // indirect. There's one sphere per entry of the scene's draw order, and the visible
+    // lists (which live in the frame's arena) hold positions in the draw order, so they
+    // stay sorted the same way.
+    culling::SphereSet m_cull_spheres;
+
+    // Totals for the throughput reported on shutdown.
+    std::uint64_t m_cull_tested_count{0};
+    double m_cull_time_ms{0.0};
 };
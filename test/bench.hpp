@@ -0,0 +1,25 @@
+#pragma once
+
+// Each of these is run by name, see bench_main.cpp.
+void bench_import();
+void bench_cull();
+void bench_scene();
+
+// Runs fn repeats times and returns the fastest run in milliseconds. The fastest run is
+// the one least disturbed by whatever else the machine was doing.
+template<typename Fn>
+double time_best_of(int repeats, Fn&& fn)
+{
+    using Clock = std::chrono::steady_clock;
+
+    double best = std::numeric_limits<double>::max();
+    for (int i{0}; i < repeats; ++i)
+    {
+        auto start = Clock::now();
+        fn();
+        auto elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start);
+        best         = std::min(best, elapsed.count());
+    }
+
+    return best;
+}
@@ -0,0 +1,63 @@
+#include "bench.hpp"
+
+#include "vk_culling.hpp"
+
+#include <random>
+
+void bench_cull()
+{
+    constexpr std::size_t object_count{100000};
+    constexpr int repeats{20};
+
+    // Spread out around the camera so that a bit over half of them end up in view, and
+    // both the rejections and the appends show up in the timings.
+    std::mt19937 generator{42};
+    std::uniform_real_distribution<float> position{-100.0f, 100.0f};
+    std::uniform_real_distribution<float> radius{0.1f, 2.0f};
+
+    culling::SphereSet spheres;
+    spheres.reserve(object_count);
+    for (std::size_t i{0}; i < object_count; ++i)
+    {
+        spheres.push_back(glm::vec4{position(generator),
+                                    position(generator),
+                                    position(generator),
+                                    radius(generator)});
+    }
+
+    auto view    = glm::lookAt(glm::vec3{0.0f, 0.0f, 100.0f},
+                            glm::vec3{0.0f},
+                            glm::vec3{0.0f, 1.0f, 0.0f});
+    auto proj    = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 250.0f);
+    auto frustum = culling::extract_frustum_planes(proj * view);
+
+    std::pmr::vector<std::uint32_t> simd;
+    std::pmr::vector<std::uint32_t> scalar;
+    simd.reserve(object_count);
+    scalar.reserve(object_count);
+
+    double simd_ms =
+        time_best_of(repeats, [&]() { culling::cull_spheres(spheres, frustum, simd); });
+    double scalar_ms = time_best_of(
+        repeats, [&]() { culling::cull_spheres_scalar(spheres, frustum, scalar); });
+
+    if (simd != scalar)
+    {
+        fmt::print("error: {} and scalar culling disagree ({} vs {} visible)\n",
+                   culling::get_simd_name(),
+                   simd.size(),
+                   scalar.size());
+        return;
+    }
+
+    fmt::print("  {} objects, {} visible\n", object_count, scalar.size());
+    fmt::print("  {:>8}: {:7.3f} ms ({:.0f} objects/ms)\n",
+               culling::get_simd_name(),
+               simd_ms,
+               object_count / simd_ms);
+    fmt::print("  {:>8}: {:7.3f} ms ({:.0f} objects/ms)\n",
+               "scalar",
+               scalar_ms,
+               object_count / scalar_ms);
+    fmt::print("  speed-up: {:.2f}x\n", scalar_ms / simd_ms);
+}
@@ -0,0 +1,60 @@
+#include "bench.hpp"
+
+#include "thread_pool.hpp"
+#include "vk_mesh.hpp"
+
+// Imports every model under models/ from source with 1 to N threads, where N is the
+// number of cores. The cache is bypassed, otherwise only the first run would import
+// anything.
+void bench_import()
+{
+    std::vector<std::filesystem::path> paths;
+    for (auto const& entry : std::filesystem::directory_iterator{"models"})
+    {
+        if (entry.path().extension() == ".obj")
+        {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    auto max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<std::string> results;
+    for (auto const& path : paths)
+    {
+        double single_thread{0.0};
+        for (std::uint32_t threads{1}; threads <= max_threads; ++threads)
+        {
+            // The calling thread takes part in parallel_for, so n threads means n - 1
+            // workers. With just the one there's no need for a pool at all.
+            std::optional<ThreadPool> pool;
+            if (threads > 1)
+            {
+                pool.emplace(threads - 1);
+            }
+
+            auto ms = time_best_of(3, [&]() {
+                Model model;
+                model.load_from_file(path, pool ? &*pool : nullptr, false, false);
+            });
+
+            if (threads == 1)
+            {
+                single_thread = ms;
+            }
+
+            results.push_back(fmt::format("{:<24} {:>3} threads {:>10.3f} ms {:>6.2f}x",
+                                          path.filename().string(),
+                                          threads,
+                                          ms,
+                                          single_thread / ms));
+        }
+    }
+
+    // Every load prints its own line, so keep the summary together at the end.
+    for (auto const& line : results)
+    {
+        fmt::print("{}\n", line);
+    }
+}
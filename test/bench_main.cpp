@@ -0,0 +1,46 @@
+#include "bench.hpp"
+
+struct Benchmark
+{
+    std::string_view name;
+    void (*run)();
+};
+
+static constexpr std::array benchmarks{
+    Benchmark{"import", bench_import},
+    Benchmark{"cull", bench_cull},
+    Benchmark{"scene", bench_scene},
+};
+
+int main(int argc, char* argv[])
+{
+    // Same as the tests: with no arguments everything runs, otherwise only the ones that
+    // are named.
+    std::vector<Benchmark> selected;
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string_view name{argv[i]};
+        auto it = std::find_if(benchmarks.begin(), benchmarks.end(), [name](auto& bench) {
+            return bench.name == name;
+        });
+        if (it == benchmarks.end())
+        {
+            fmt::print("error: unknown benchmark {}\n", name);
+            return 1;
+        }
+        selected.push_back(*it);
+    }
+
+    if (selected.empty())
+    {
+        selected.assign(benchmarks.begin(), benchmarks.end());
+    }
+
+    for (auto const& bench : selected)
+    {
+        fmt::print("running {}\n", bench.name);
+        bench.run();
+    }
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "bench.hpp"
+
+#include "vk_scene.hpp"
+
+void bench_scene()
+{
+    // 1000 groups of 100: a root with 99 children, which is about the shape of a scene
+    // made of props that are each a handful of parts.
+    constexpr std::uint32_t group_count{1000};
+    constexpr std::uint32_t group_size{100};
+    constexpr int repeats{20};
+
+    Scene scene;
+    scene.reserve(group_count * group_size);
+    for (std::uint32_t group{0}; group < group_count; ++group)
+    {
+        auto root = scene.add_object(
+            {.position = glm::vec3{static_cast<float>(group), 0.0f, 0.0f}});
+        for (std::uint32_t i{1}; i < group_size; ++i)
+        {
+            auto object = root + i;
+            scene.add_object({.position = glm::vec3{0.0f, static_cast<float>(i), 0.0f},
+                              .parent   = root,
+                              .mesh     = object % 64,
+                              .pipeline = object % 2,
+                              .material = object % 16});
+        }
+    }
+    scene.update();
+    scene.sort();
+
+    // Moving one root dirties its whole group, so this is the usual case of a single
+    // object moving around.
+    std::size_t rebuilt{0};
+    float offset{0.0f};
+    auto subtree_ms = time_best_of(repeats, [&]() {
+        scene.set_position(0, glm::vec3{offset += 1.0f, 0.0f, 0.0f});
+        rebuilt = scene.update();
+    });
+
+    auto all_ms = time_best_of(repeats, [&]() {
+        for (std::uint32_t group{0}; group < group_count; ++group)
+        {
+            scene.set_position(group * group_size, glm::vec3{offset += 1.0f});
+        }
+        scene.update();
+    });
+
+    // A material change on a single object is enough to throw the whole order out.
+    auto sort_ms = time_best_of(repeats, [&]() {
+        scene.set_material(1, scene.get_material(1) == 0 ? 1 : 0);
+        scene.sort();
+    });
+
+    fmt::print("  {} objects, {} drawn\n", scene.size(), scene.get_draw_order().size());
+    fmt::print("  {:<32} {:7.3f} ms\n",
+               fmt::format("update, one subtree ({} rebuilt)", rebuilt),
+               subtree_ms);
+    fmt::print("  {:<32} {:7.3f} ms\n", "update, every subtree", all_ms);
+    fmt::print("  {:<32} {:7.3f} ms\n", "sort", sort_ms);
+}
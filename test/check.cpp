@@ -0,0 +1,17 @@
+#include "check.hpp"
+
+namespace check
+{
+    static std::atomic<std::size_t> failure_count{0};
+
+    void report_failure(char const* expression, char const* file, int line)
+    {
+        fmt::print("error: {}({}): check failed: {}\n", file, line, expression);
+        failure_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::size_t get_failure_count()
+    {
+        return failure_count.load(std::memory_order_relaxed);
+    }
+} // namespace check
@@ -0,0 +1,12 @@
+#pragma once
+
+// Just enough to write the tests with. A failed check is reported and counted, but the
+// test carries on so that a single run shows every failure.
+#define CHECK(expr) \
+    ((expr) ? static_cast<void>(0) : check::report_failure(#expr, __FILE__, __LINE__))
+
+namespace check
+{
+    void report_failure(char const* expression, char const* file, int line);
+    std::size_t get_failure_count();
+} // namespace check
@@ -0,0 +1,55 @@
+#include "check.hpp"
+#include "test_cases.hpp"
+
+#include "allocation_counter.hpp"
+#include "vulkan_engine.hpp"
+
+void test_steady_state_allocations()
+{
+    // Long enough for the arenas to settle and for any textures to finish streaming in.
+    constexpr int warm_up_frames{120};
+    constexpr int frame_count{240};
+
+    if (!allocation_counter::is_enabled())
+    {
+        fmt::print("skipping: built without VULKAN_INTRO_COUNT_ALLOCATIONS\n");
+        return;
+    }
+
+    std::array<std::pair<RenderMode, std::string_view>, 3> modes{
+        {{RenderMode::eDirect, "direct"},
+         {RenderMode::eIndirect, "indirect"},
+         {RenderMode::eInstanced, "instanced"}}
+    };
+
+    for (auto [mode, name] : modes)
+    {
+        // Headless, so this only needs a device (a software one will do), not a display.
+        VulkanEngine engine;
+        engine.set_headless(true);
+        engine.set_window_extent({320, 180});
+        engine.set_render_mode(mode);
+        engine.init();
+
+        for (int i{0}; i < warm_up_frames; ++i)
+        {
+            engine.render();
+        }
+
+        auto before = allocation_counter::get_count();
+        for (int i{0}; i < frame_count; ++i)
+        {
+            engine.render();
+        }
+        auto allocations = allocation_counter::get_count() - before;
+
+        if (allocations != 0)
+        {
+            fmt::print("{} mode: {} allocations over {} frames\n",
+                       name,
+                       allocations,
+                       frame_count);
+        }
+        CHECK(allocations == 0);
+    }
+}
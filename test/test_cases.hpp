@@ -0,0 +1,8 @@
+#pragma once
+
+// Each of these is registered with CTest under its own name, see test_main.cpp.
+void test_parallel_import();
+void test_optimise_meshes();
+void test_packed_vertices();
+void test_cull_simd_matches_scalar();
+void test_steady_state_allocations();
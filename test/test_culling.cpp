@@ -0,0 +1,58 @@
+#include "check.hpp"
+#include "test_cases.hpp"
+
+#include "vk_culling.hpp"
+
+#include <random>
+
+void test_cull_simd_matches_scalar()
+{
+    // A camera at the origin looking a few different ways, with the spheres scattered all
+    // around it so every plane rejects some of them.
+    std::array<glm::vec3, 4> directions{glm::vec3{0.0f, 0.0f, -1.0f},
+                                        glm::vec3{1.0f, 0.0f, 0.0f},
+                                        glm::vec3{0.0f, 0.5f, 1.0f},
+                                        glm::vec3{-1.0f, -1.0f, 0.3f}};
+
+    // None of the directions are vertical, so this always works as the up vector.
+    glm::vec3 up{0.0f, 1.0f, 0.0f};
+    glm::mat4 proj = glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+
+    std::mt19937 generator{42};
+    std::uniform_real_distribution<float> position{-120.0f, 120.0f};
+    std::uniform_real_distribution<float> radius{0.01f, 5.0f};
+
+    // Sizes that aren't a multiple of the lane count exercise the padding.
+    std::pmr::vector<std::uint32_t> simd;
+    std::pmr::vector<std::uint32_t> scalar;
+    for (std::size_t count : {1, 7, 8, 1003, 100000})
+    {
+        culling::SphereSet spheres;
+        spheres.reserve(count);
+        for (std::size_t i{0}; i < count; ++i)
+        {
+            spheres.push_back(glm::vec4{position(generator),
+                                        position(generator),
+                                        position(generator),
+                                        radius(generator)});
+        }
+
+        for (auto direction : directions)
+        {
+            auto view    = glm::lookAt(glm::vec3{0.0f}, direction, up);
+            auto frustum = culling::extract_frustum_planes(proj * view);
+
+            culling::cull_spheres(spheres, frustum, simd);
+            culling::cull_spheres_scalar(spheres, frustum, scalar);
+            CHECK(simd.size() == scalar.size());
+            CHECK(std::equal(simd.begin(), simd.end(), scalar.begin(), scalar.end()));
+
+            // Otherwise the comparison doesn't say much.
+            if (count > 1000)
+            {
+                CHECK(!scalar.empty());
+                CHECK(scalar.size() < count);
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#include "check.hpp"
+#include "test_cases.hpp"
+
+#include "vk_mesh.hpp"
+
+// Every object is its own mesh, and each one is a grid of a different size sitting at
+// its own x offset, so a mesh that ends up in another mesh's range is easy to spot.
+static constexpr std::uint32_t object_count{6};
+static constexpr float object_spacing{10.0f};
+
+static std::uint32_t get_columns(std::uint32_t object)
+{
+    return object + 1;
+}
+
+static std::uint32_t get_rows(std::uint32_t object)
+{
+    return 2 * object + 1;
+}
+
+static void write_test_model(std::filesystem::path const& path)
+{
+    std::ofstream stream{path};
+
+    // OBJ indices are 1-based and count across the whole file.
+    std::uint32_t first_vertex{1};
+    for (std::uint32_t object{0}; object < object_count; ++object)
+    {
+        auto columns = get_columns(object);
+        auto rows    = get_rows(object);
+
+        stream << fmt::format("o grid_{}\n", object);
+        for (std::uint32_t row{0}; row <= rows; ++row)
+        {
+            for (std::uint32_t column{0}; column <= columns; ++column)
+            {
+                stream << fmt::format("v {} 0 {}\n",
+                                      object * object_spacing + column,
+                                      row);
+            }
+        }
+        stream << "vn 0 1 0\n";
+
+        auto normal = object + 1;
+        auto vertex = [&](std::uint32_t row, std::uint32_t column) {
+            return fmt::format("{}//{}",
+                               first_vertex + row * (columns + 1) + column,
+                               normal);
+        };
+
+        for (std::uint32_t row{0}; row < rows; ++row)
+        {
+            for (std::uint32_t column{0}; column < columns; ++column)
+            {
+                stream << fmt::format("f {} {} {} {}\n",
+                                      vertex(row, column),
+                                      vertex(row + 1, column),
+                                      vertex(row + 1, column + 1),
+                                      vertex(row, column + 1));
+            }
+        }
+
+        first_vertex += (rows + 1) * (columns + 1);
+    }
+}
+
+// Every mesh is converted into a range that is laid out before any of them run, so the
+// packed geometry has to come out the same however many threads do the converting, and
+// every range has to hold the mesh it was laid out for.
+void test_parallel_import()
+{
+    auto path = std::filesystem::temp_directory_path() / "vulkan_intro_test_import.obj";
+    write_test_model(path);
+
+    ThreadPool pool{3};
+    Model serial;
+    Model parallel;
+    CHECK(serial.load_from_file(path, nullptr, false, false));
+    CHECK(parallel.load_from_file(path, &pool, false, false));
+    std::filesystem::remove(path);
+
+    CHECK(serial.meshes.size() == object_count);
+    CHECK(parallel.meshes.size() == object_count);
+    for (std::size_t i{0}; i < std::min(serial.meshes.size(), parallel.meshes.size());
+         ++i)
+    {
+        auto const& a = serial.meshes[i];
+        auto const& b = parallel.meshes[i];
+        CHECK(a.first_index == b.first_index);
+        CHECK(a.index_count == b.index_count);
+        CHECK(a.vertex_offset == b.vertex_offset);
+        CHECK(a.vertex_count == b.vertex_count);
+    }
+
+    auto serial_vertices   = std::as_bytes(serial.get_vertices());
+    auto parallel_vertices = std::as_bytes(parallel.get_vertices());
+    CHECK(!serial_vertices.empty());
+    CHECK(std::ranges::equal(serial_vertices, parallel_vertices));
+    CHECK(std::ranges::equal(serial.get_indices(), parallel.get_indices()));
+
+    // Matching the serial import only proves the threads didn't change anything, so
+    // also check that every range really holds its own grid.
+    auto vertices = parallel.get_vertices();
+    auto indices  = parallel.get_indices();
+    for (std::uint32_t object{0}; object < parallel.meshes.size(); ++object)
+    {
+        auto const& mesh = parallel.meshes[object];
+        CHECK(mesh.index_count == get_columns(object) * get_rows(object) * 6);
+        CHECK(mesh.first_index + mesh.index_count <= indices.size());
+        CHECK(static_cast<std::size_t>(mesh.vertex_offset) + mesh.vertex_count
+              <= vertices.size());
+
+        // The ranges are packed back to back, in the order of the file.
+        if (object > 0)
+        {
+            auto const& previous = parallel.meshes[object - 1];
+            CHECK(mesh.first_index == previous.first_index + previous.index_count);
+            CHECK(mesh.vertex_offset
+                  == previous.vertex_offset
+                         + static_cast<std::int32_t>(previous.vertex_count));
+        }
+
+        // A little slack, in case the packed layout rounds the positions.
+        float min_x = object * object_spacing - 0.1f;
+        float max_x = object * object_spacing + get_columns(object) + 0.1f;
+        for (std::uint32_t i{0}; i < mesh.vertex_count; ++i)
+        {
+            auto x = vertices[mesh.vertex_offset + i].get_position().x;
+            CHECK(x >= min_x && x <= max_x);
+        }
+
+        for (std::uint32_t i{0}; i < mesh.index_count; ++i)
+        {
+            CHECK(indices[mesh.first_index + i] < mesh.vertex_count);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#include "check.hpp"
+#include "test_cases.hpp"
+
+struct TestCase
+{
+    std::string_view name;
+    void (*run)();
+};
+
+static constexpr std::array test_cases{
+    TestCase{"parallel_import", test_parallel_import},
+    TestCase{"optimise_meshes", test_optimise_meshes},
+    TestCase{"packed_vertices", test_packed_vertices},
+    TestCase{"cull_simd_matches_scalar", test_cull_simd_matches_scalar},
+    TestCase{"steady_state_allocations", test_steady_state_allocations},
+};
+
+int main(int argc, char* argv[])
+{
+    // With no arguments every test runs, otherwise only the ones that are named. CTest
+    // runs them one at a time so they show up separately.
+    std::vector<TestCase> selected;
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string_view name{argv[i]};
+        auto it = std::find_if(test_cases.begin(), test_cases.end(), [name](auto& test) {
+            return test.name == name;
+        });
+        if (it == test_cases.end())
+        {
+            fmt::print("error: unknown test {}\n", name);
+            return 1;
+        }
+        selected.push_back(*it);
+    }
+
+    if (selected.empty())
+    {
+        selected.assign(test_cases.begin(), test_cases.end());
+    }
+
+    for (auto const& test : selected)
+    {
+        fmt::print("running {}\n", test.name);
+        test.run();
+    }
+
+    auto failures = check::get_failure_count();
+    if (failures != 0)
+    {
+        fmt::print("{} check(s) failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "check.hpp"
+#include "test_cases.hpp"
+
+#include "vk_mesh.hpp"
+#include "vk_mesh_optimiser.hpp"
+
+// Reduces every triangle to the bytes of its three vertices, rotated so the smallest one
+// comes first. Reordering may move triangles around and rotate them, but it must never
+// change what they are or flip their winding, so the sorted lists have to match.
+static std::vector<std::string> get_triangles(std::span<Vertex const> vertices,
+                                              std::span<std::uint32_t const> indices)
+{
+    std::vector<std::string> triangles;
+    triangles.reserve(indices.size() / 3);
+    for (std::size_t i{0}; i + 2 < indices.size(); i += 3)
+    {
+        std::array<std::string, 3> corners;
+        for (std::size_t j{0}; j < 3; ++j)
+        {
+            auto bytes = std::as_bytes(std::span{&vertices[indices[i + j]], 1});
+            corners[j].assign(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+        }
+
+        auto first = std::min_element(corners.begin(), corners.end()) - corners.begin();
+        std::rotate(corners.begin(), corners.begin() + first, corners.end());
+        triangles.push_back(corners[0] + corners[1] + corners[2]);
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+// monkey_flat.obj has a separate vertex for every corner of every face, so it's the one
+// where deduplication has something to do.
+void test_optimise_meshes()
+{
+    for (auto name : {"monkey_smooth.obj", "monkey_flat.obj"})
+    {
+        Model model;
+        CHECK(model.load_from_file(std::filesystem::path{"models"} / name,
+                                   nullptr,
+                                   false,
+                                   false));
+
+        std::size_t vertices_before{0};
+        std::size_t vertices_after{0};
+        for (auto const& mesh : model.meshes)
+        {
+            auto source_vertices =
+                model.get_vertices().subspan(mesh.vertex_offset, mesh.vertex_count);
+            auto source_indices =
+                model.get_indices().subspan(mesh.first_index, mesh.index_count);
+
+            std::vector<Vertex> vertices(source_vertices.begin(), source_vertices.end());
+            std::vector<std::uint32_t> indices(source_indices.begin(),
+                                               source_indices.end());
+
+            auto result = mesh_optimiser::optimise(vertices, indices);
+            CHECK(result.vertex_count <= vertices.size());
+            CHECK(result.after.acmr <= result.before.acmr);
+            CHECK(std::all_of(indices.begin(), indices.end(), [&](std::uint32_t index) {
+                return index < result.vertex_count;
+            }));
+
+            auto optimised = std::span{vertices}.first(result.vertex_count);
+            CHECK(get_triangles(source_vertices, source_indices)
+                  == get_triangles(optimised, indices));
+
+            vertices_before += vertices.size();
+            vertices_after += result.vertex_count;
+        }
+
+        CHECK(vertices_after <= vertices_before);
+        if (std::string_view{name} == "monkey_flat.obj")
+        {
+            CHECK(vertices_after < vertices_before);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#include "check.hpp"
+#include "test_cases.hpp"
+
+#include "vk_mesh.hpp"
+
+#include <random>
+
+// The bounds documented on vertex_packing.
+static constexpr float position_error{1.0f / 2048.0f};
+static constexpr float normal_error{1e-4f};
+static constexpr float colour_error{0.5f / 255.0f + 1e-6f};
+static constexpr float uv_error{0.5f / 65535.0f + 1e-7f};
+
+// Vertex goes through the same encoders in the packed layout, and stores everything as
+// is otherwise.
+#if defined(VULKAN_INTRO_PACKED_VERTICES)
+static constexpr float vertex_position_error{position_error};
+static constexpr float vertex_normal_error{normal_error};
+static constexpr float vertex_colour_error{colour_error};
+static constexpr float vertex_uv_error{uv_error};
+#else
+static constexpr float vertex_position_error{0.0f};
+static constexpr float vertex_normal_error{0.0f};
+static constexpr float vertex_colour_error{0.0f};
+static constexpr float vertex_uv_error{0.0f};
+#endif
+
+void test_packed_vertices()
+{
+    using namespace vertex_packing;
+
+    std::vector<glm::vec3> positions{
+        glm::vec3{0.0f},
+        glm::vec3{1.0f, -0.5f, 0.25f},
+        glm::vec3{0.3333f, -1.7f, 2.9f},
+        glm::vec3{123.456f, -0.001f, 1000.0f},
+    };
+    std::vector<glm::vec3> colours{
+        glm::vec3{0.0f},
+        glm::vec3{1.0f},
+        glm::vec3{0.5f, 0.25f, 0.75f},
+        glm::vec3{0.1f, 0.9f, 0.333f},
+    };
+    std::vector<glm::vec2> uvs{
+        glm::vec2{0.0f},
+        glm::vec2{1.0f},
+        glm::vec2{0.5f, 0.123f},
+        glm::vec2{0.999f, 0.0001f},
+    };
+
+    // The axes and diagonals are where the octahedral mapping folds, so they always go
+    // in. The rest are spread over the whole sphere.
+    std::vector<glm::vec3> normals{
+        glm::vec3{1.0f, 0.0f, 0.0f},
+        glm::vec3{-1.0f, 0.0f, 0.0f},
+        glm::vec3{0.0f, 1.0f, 0.0f},
+        glm::vec3{0.0f, -1.0f, 0.0f},
+        glm::vec3{0.0f, 0.0f, 1.0f},
+        glm::vec3{0.0f, 0.0f, -1.0f},
+        glm::normalize(glm::vec3{1.0f, 1.0f, 1.0f}),
+        glm::normalize(glm::vec3{-1.0f, 1.0f, -1.0f}),
+        glm::normalize(glm::vec3{1.0f, -1.0f, -1.0f}),
+    };
+    std::mt19937 generator{42};
+    std::normal_distribution<float> distribution;
+    for (int i{0}; i < 10000; ++i)
+    {
+        glm::vec3 normal{distribution(generator),
+                         distribution(generator),
+                         distribution(generator)};
+        if (glm::length(normal) > 1e-3f)
+        {
+            normals.push_back(glm::normalize(normal));
+        }
+    }
+
+    auto within = [](auto decoded, auto original, float relative, float absolute) {
+        auto bound = glm::abs(original) * relative + absolute;
+        return glm::all(glm::lessThanEqual(glm::abs(decoded - original), bound));
+    };
+
+    for (std::size_t i{0}; i < normals.size(); ++i)
+    {
+        auto position = positions[i % positions.size()];
+        auto normal   = normals[i];
+        auto colour   = colours[i % colours.size()];
+        auto uv       = uvs[i % uvs.size()];
+
+        CHECK(within(unpack_position(pack_position(position)),
+                     position,
+                     position_error,
+                     0.0f));
+        CHECK(glm::length(unpack_normal(pack_normal(normal)) - normal) <= normal_error);
+        CHECK(within(unpack_colour(pack_colour(colour)), colour, 0.0f, colour_error));
+        CHECK(within(unpack_uv(pack_uv(uv)), uv, 0.0f, uv_error));
+
+        auto vertex = make_vertex(position, normal, colour, uv);
+        CHECK(within(vertex.get_position(), position, vertex_position_error, 0.0f));
+        CHECK(glm::length(vertex.get_normal() - normal) <= vertex_normal_error);
+        CHECK(within(vertex.get_colour(), colour, 0.0f, vertex_colour_error));
+        CHECK(within(vertex.get_uv(), uv, 0.0f, vertex_uv_error));
+    }
+}